@@ -6,7 +6,7 @@
 #include "benchmark/benchmark.h"
 
 #include "spdlog/spdlog.h"
-#include "spdlog/details/pattern_formatter.h"
+#include "spdlog/details/compiled_pattern_formatter.h"
 
 void bench_scoped_pad(benchmark::State &state, size_t wrapped_size, spdlog::details::padding_info padinfo)
 {
@@ -38,6 +38,28 @@ void bench_formatter(benchmark::State &state, std::string pattern)
     }
 }
 
+template<typename Pattern>
+void bench_compiled_formatter(benchmark::State &state)
+{
+    spdlog::compiled_pattern_formatter<Pattern> formatter;
+    fmt::memory_buffer dest;
+    std::string logger_name = "logger-name";
+    const char *text = "Hello. This is some message with length of 80                                   ";
+
+    spdlog::details::log_msg msg(&logger_name, spdlog::level::info, text);
+
+    for (auto _ : state)
+    {
+        dest.clear();
+        formatter.format(msg, dest);
+        benchmark::DoNotOptimize(dest);
+    }
+}
+
+SPDLOG_COMPILED_PATTERN(pattern_1, "[%D %X] [%l] [%n] %v");
+SPDLOG_COMPILED_PATTERN(pattern_2, "[%Y-%m-%d %H:%M:%S.%e] [%l] [%n] %v");
+SPDLOG_COMPILED_PATTERN(pattern_3, "[%Y-%m-%d %H:%M:%S.%e] [%l] [%n] [%t] %v");
+
 void bench_formatters()
 {
     // basic patterns(single flag)
@@ -66,6 +88,12 @@ void bench_formatters()
     {
         benchmark::RegisterBenchmark(pattern.c_str(), bench_formatter, pattern)->Iterations(2500000);
     }
+
+    // the same patterns, compiled
+    benchmark::RegisterBenchmark("compiled [%D %X] [%l] [%n] %v", bench_compiled_formatter<pattern_1>)->Iterations(2500000);
+    benchmark::RegisterBenchmark("compiled [%Y-%m-%d %H:%M:%S.%e] [%l] [%n] %v", bench_compiled_formatter<pattern_2>)->Iterations(2500000);
+    benchmark::RegisterBenchmark("compiled [%Y-%m-%d %H:%M:%S.%e] [%l] [%n] [%t] %v", bench_compiled_formatter<pattern_3>)
+        ->Iterations(2500000);
 }
 
 int main(int argc, char *argv[])
@@ -21,18 +21,31 @@
 #include "spdlog/details/registry.h"
 #include "spdlog/details/thread_pool.h"
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 
 namespace spdlog {
 
 namespace details {
+#if defined(SPDLOG_BYTE_RING_QUEUE)
+// queue size is in bytes - room for about 8192 typical messages
+static const size_t default_async_q_size = 8192 * 256;
+#else
 static const size_t default_async_q_size = 8192;
+#endif
+
+// make tp the global thread pool, drained by spdlog::shutdown(..)
+inline void set_global_tp(std::shared_ptr<thread_pool> tp)
+{
+    auto *pool = tp.get();
+    registry::instance().set_tp(std::move(tp), [pool](std::chrono::milliseconds timeout) { return pool->drain(timeout); });
 }
+} // namespace details
 
 // async logger factory - creates async loggers backed with thread pool.
 // if a global thread pool doesn't already exist, create it with default queue
-// size of 8192 items and single thread.
+// size of 8192 items (2MB if SPDLOG_BYTE_RING_QUEUE is defined) and single thread.
 template<async_overflow_policy OverflowPolicy = async_overflow_policy::block>
 struct async_factory_impl
 {
@@ -47,7 +60,7 @@ struct async_factory_impl
         if (tp == nullptr)
         {
             tp = std::make_shared<details::thread_pool>(details::default_async_q_size, 1);
-            registry_inst.set_tp(tp);
+            details::set_global_tp(tp);
         }
 
         auto sink = std::make_shared<Sink>(std::forward<SinkArgs>(args)...);
@@ -59,11 +72,15 @@ struct async_factory_impl
 
 using async_factory = async_factory_impl<async_overflow_policy::block>;
 using async_factory_nonblock = async_factory_impl<async_overflow_policy::overrun_oldest>;
+using async_factory_timeout = async_factory_impl<async_overflow_policy::block_with_timeout>;
+using async_factory_discard = async_factory_impl<async_overflow_policy::discard_new>;
+using async_factory_spill = async_factory_impl<async_overflow_policy::spill>;
 
-template<typename Sink, typename... SinkArgs>
+// e.g. create_async<sinks::stdout_sink_mt, async_overflow_policy::discard_new>("name")
+template<typename Sink, async_overflow_policy OverflowPolicy = async_overflow_policy::block, typename... SinkArgs>
 inline std::shared_ptr<spdlog::logger> create_async(std::string logger_name, SinkArgs &&... sink_args)
 {
-    return async_factory::create<Sink>(std::move(logger_name), std::forward<SinkArgs>(sink_args)...);
+    return async_factory_impl<OverflowPolicy>::template create<Sink>(std::move(logger_name), std::forward<SinkArgs>(sink_args)...);
 }
 
 template<typename Sink, typename... SinkArgs>
@@ -76,7 +93,43 @@ inline std::shared_ptr<spdlog::logger> create_async_nb(std::string logger_name,
 inline void init_thread_pool(size_t q_size, size_t thread_count)
 {
     auto tp = std::make_shared<details::thread_pool>(q_size, thread_count);
-    details::registry::instance().set_tp(std::move(tp));
+    details::set_global_tp(std::move(tp));
+}
+
+// set global thread pool whose threads drain up to batch_size messages at once.
+inline void init_thread_pool(size_t q_size, size_t thread_count, size_t batch_size)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, batch_size);
+    details::set_global_tp(std::move(tp));
+}
+
+// set global thread pool whose threads each have their own queue (see async_queue_sharding).
+inline void init_thread_pool(size_t q_size, size_t thread_count, size_t batch_size, async_queue_sharding sharding)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, batch_size, sharding);
+    details::set_global_tp(std::move(tp));
+}
+
+// set global thread pool whose threads are placed according to options (see thread_options).
+inline void init_thread_pool(size_t q_size, size_t thread_count, const thread_options &options)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, options);
+    details::set_global_tp(std::move(tp));
+}
+
+// set global thread pool whose queues' memory is allocated according to memory (see async_queue_memory).
+inline void init_thread_pool(size_t q_size, size_t thread_count, const async_queue_memory &memory)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, memory);
+    details::set_global_tp(std::move(tp));
+}
+
+// set global thread pool with a high priority lane (see async_priority_lane).
+inline void init_thread_pool(
+    size_t q_size, size_t thread_count, size_t batch_size, async_queue_sharding sharding, async_priority_lane high_lane)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, batch_size, sharding, high_lane);
+    details::set_global_tp(std::move(tp));
 }
 
 // get the global thread pool.
@@ -22,22 +22,129 @@
 #include "spdlog/common.h"
 #include "spdlog/logger.h"
 
+#include <array>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace spdlog {
 
 // Async overflow policy - block by default.
 enum class async_overflow_policy
 {
-    block,         // Block until message can be enqueued
-    overrun_oldest // Discard oldest message in the queue if full when trying to
-                   // add new item.
+    block,              // Block until message can be enqueued
+    overrun_oldest,     // Discard oldest message in the queue if full when trying to
+                        // add new item.
+    block_with_timeout, // Block up to the logger's block_timeout(), then discard the new message
+    discard_new,        // Discard the new message right away if the queue is full (without
+                        // taking the queue's lock to find out)
+    spill               // Append the new message to the thread pool's spill file if the queue is
+                        // full (see thread_pool::set_spill_file(..)). Same as block without one.
+};
+
+// Whether the threads of a thread pool share a single queue, or each thread has its
+// own queue. With per_thread, each async logger is pinned to one of the threads
+// (see async_logger::set_shard(..)), so its messages are processed in order and
+// loggers pinned to different threads write to their sinks in parallel.
+enum class async_queue_sharding
+{
+    shared,
+    per_thread
+};
+
+// How the threads of a thread pool wait for messages when their queue is empty.
+// Spinning reacts faster to new messages at the cost of a busy cpu core per thread.
+// It pays off most with SPDLOG_LOCKFREE_QUEUE, where checking the queue takes no lock.
+enum class async_wait_strategy
+{
+    blocking,       // sleep on the queue until a message arrives (default)
+    spin_then_park, // spin for a short while, then yield a few times, then sleep on the queue
+    spin_yield,     // spin for a short while, then keep yielding the cpu to other threads
+    busy_spin       // never give up the cpu
+};
+
+// Lanes of a thread pool queue.
+enum class async_lane
+{
+    normal,
+    high
+};
+
+// High priority lane of a thread pool (disabled if q_max_items is 0).
+// Log messages of level min_level and above go to a separate queue with its own
+// capacity and overflow policy, which the threads drain before the normal lane - so
+// a flood of lower level messages can neither overrun nor delay them.
+// Messages of the high lane may be processed before normal lane messages that were
+// logged earlier, but never after normal lane messages (or flushes) logged later.
+// The high lane is drained until empty each time, so it should be reserved for rare messages.
+struct async_priority_lane
+{
+    size_t q_max_items = 0;
+    level::level_enum min_level = level::warn;
+    async_overflow_policy overflow_policy = async_overflow_policy::block;
+};
+
+// Producer side batching of a thread pool (disabled if max_items is 0 or 1, see
+// thread_pool::set_producer_batching(..)).
+// Each thread stages the log messages it posts, and puts them in the queue at once -
+// one lock or one wake up for the whole batch - when max_items are staged, when a
+// message of publish_level or above is logged, before a flush, and when the thread exits.
+// The pool's threads put in the queue the messages staged for longer than max_delay.
+// Only the normal lane messages of loggers with the block policy are staged, and
+// none without thread local storage (SPDLOG_NO_TLS).
+struct async_producer_batching
+{
+    size_t max_items = 0;
+    std::chrono::milliseconds max_delay{1};
+    level::level_enum publish_level = level::err;
+};
+
+// Automatic thread count of a thread pool with a shared queue (disabled if max_threads
+// is 0, see thread_pool::set_autoscale(..)).
+// A thread is added whenever a thread finds grow_depth or more messages in the queue
+// (up to max_threads), and a thread that had nothing to do for idle_shrink retires
+// (down to min_threads).
+struct async_autoscale
+{
+    size_t min_threads = 1;
+    size_t max_threads = 0;
+    size_t grow_depth = 1024;
+    std::chrono::milliseconds idle_shrink{10000};
+};
+
+// Counters of a thread pool queue (see thread_pool::telemetry()).
+// They are read without locking, so they may be slightly off while messages are logged.
+struct async_queue_stats
+{
+    // blocked_waits[0] counts producer waits under 1us, blocked_waits[i] waits of
+    // [2^(i-1), 2^i) us, and the last bucket all longer waits.
+    static const size_t wait_buckets = 24;
+
+    size_t depth = 0;           // messages in the queue (and its spill file)
+    size_t high_water_mark = 0; // the highest depth seen
+    size_t enqueued = 0;        // all messages put in the queue (flushes and control messages included)
+    size_t dequeued = 0;        // messages taken out by the threads
+    size_t overruns = 0;        // messages dropped to make room (overrun_oldest)
+    size_t timeouts = 0;        // new messages dropped after blocking for too long (block_with_timeout)
+    size_t discarded_new = 0;   // new messages dropped because the queue was full (discard_new)
+    size_t spilled = 0;         // messages put in the spill file instead (counted as enqueued too)
+    std::array<size_t, wait_buckets> blocked_waits{};
+    std::chrono::nanoseconds blocked_time{0}; // total time producers were blocked on a full queue
+};
+
+// Counters of all the queues of a thread pool - one per thread if sharded.
+struct async_pool_stats
+{
+    std::vector<async_queue_stats> queues;
+    std::vector<async_queue_stats> high_queues; // empty unless the high priority lane is enabled
 };
 
 namespace details {
 class thread_pool;
+class async_quota;
+struct async_msg;
 }
 
 class async_logger final : public std::enable_shared_from_this<async_logger>, public logger
@@ -55,18 +162,64 @@ public:
     async_logger(std::string logger_name, sink_ptr single_sink, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
 
+    // waits until the thread pool processed the messages of this logger that are still queued
+    ~async_logger() override;
+
     std::shared_ptr<logger> clone(std::string new_name) override;
 
+    // if enabled, log calls whose arguments are all arithmetic types or strings only copy
+    // them into the queue, and the thread pool formats them (off by default).
+    // other log calls are formatted by the caller as usual.
+    void set_deferred_formatting(bool enabled);
+    bool deferred_formatting() const;
+
+    // thread of a sharded thread pool that processes this logger's messages (modulo the
+    // number of threads). defaults to a hash of the logger's name.
+    // loggers that write to the same sink should be pinned to the same thread to keep
+    // the sink's output ordered. should be set before logging.
+    void set_shard(size_t shard);
+    size_t shard() const;
+
+    // number of this logger's messages the thread pool dropped to make room (overrun_oldest)
+    size_t overrun_counter() const;
+
+    // how long block_with_timeout waits for room in the queue (default 10ms)
+    void set_block_timeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds block_timeout() const;
+
+    // limit the number of this logger's messages in the thread pool (queued or being
+    // processed) to max_in_flight, 0 for no limit - a shorthand for a quota group of its
+    // own, named after the logger.
+    void set_quota(size_t max_in_flight);
+
+    // share the in-flight limit of the thread pool's quota group (see thread_pool::set_quota(..))
+    // with the other loggers of the group. an empty group leaves the logger without quota.
+    // once the group is out of slots, new messages wait for one with the block policy (up to
+    // the block timeout with block_with_timeout), and are dropped with the other policies.
+    void set_quota_group(const std::string &group);
+
 protected:
     void sink_it_(details::log_msg &msg) override;
+    void sink_it_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn) override;
     void flush_() override;
+    void flush_with_future_(std::unique_ptr<std::promise<void>> flushed) override;
 
+    bool backend_format_(details::async_msg &incoming_async_msg, fmt::memory_buffer &buf);
     void backend_log_(const details::log_msg &incoming_log_msg);
+    void backend_log_batch_(const details::log_msg *incoming_log_msgs, size_t count);
     void backend_flush_();
 
 private:
     std::weak_ptr<details::thread_pool> thread_pool_;
+    // used by producers instead of locking thread_pool_ (see pool_guard.h)
+    details::thread_pool *thread_pool_ptr_;
+    std::shared_future<void> thread_pool_stopped_;
     async_overflow_policy overflow_policy_;
+    std::atomic<size_t> shard_;
+    std::atomic<size_t> overruns_{0};
+    std::atomic<std::chrono::milliseconds::rep> block_timeout_{10};
+    // owned by the thread pool
+    std::atomic<details::async_quota *> quota_{nullptr};
 };
 } // namespace spdlog
 
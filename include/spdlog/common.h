@@ -17,6 +17,7 @@
 #include <cstring>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #if defined(SPDLOG_WCHAR_FILENAMES) || defined(SPDLOG_WCHAR_TO_UTF8_SUPPORT)
 #include <codecvt>
@@ -220,6 +221,40 @@ struct source_loc
     uint32_t line;
 };
 
+//
+// Placement and hooks of the threads started by spdlog (thread pool workers and the
+// periodic flusher). Thread i (the index of a worker in its pool, 0 for the flusher):
+//    runs on the cpus in cpu_affinity[i % cpu_affinity.size()] (any cpu if empty),
+//    is named name followed by i for pool workers (names are cut to 15 chars on linux),
+//    gets sched_policy (SCHED_FIFO, SCHED_RR..) and sched_priority if sched_policy >= 0,
+//    calls on_start(i) before doing any work and on_stop(i) before it exits.
+// The thread's creator throws spdlog_ex if any of it fails (or on_start throws).
+//
+struct thread_options
+{
+    std::vector<std::vector<size_t>> cpu_affinity;
+    std::string name;
+    int sched_policy = -1;
+    int sched_priority = 0;
+    std::function<void(size_t)> on_start;
+    std::function<void(size_t)> on_stop;
+};
+
+//
+// Memory of the async queues (all off by default):
+//    prefault: touch all of it on construction, so the first pass through a large queue
+//              doesn't page fault in the middle of a burst.
+//    huge_pages: back it with transparent huge pages (linux, best effort), which saves tlb
+//                misses on large queues.
+//    lock: mlock it, so it is never swapped out (throws spdlog_ex if not permitted).
+//
+struct async_queue_memory
+{
+    bool prefault = false;
+    bool huge_pages = false;
+    bool lock = false;
+};
+
 namespace details {
 // make_unique support for pre c++14
 
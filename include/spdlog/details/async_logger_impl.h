@@ -10,7 +10,9 @@
 
 #include "spdlog/details/thread_pool.h"
 
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -19,8 +21,15 @@ inline spdlog::async_logger::async_logger(
     std::string logger_name, It begin, It end, std::weak_ptr<details::thread_pool> tp, async_overflow_policy overflow_policy)
     : logger(std::move(logger_name), begin, end)
     , thread_pool_(std::move(tp))
+    , thread_pool_ptr_(nullptr)
     , overflow_policy_(overflow_policy)
+    , shard_(std::hash<std::string>()(name_))
 {
+    if (auto pool_ptr = thread_pool_.lock())
+    {
+        thread_pool_ptr_ = pool_ptr.get();
+        thread_pool_stopped_ = pool_ptr->stopped();
+    }
 }
 
 inline spdlog::async_logger::async_logger(
@@ -35,15 +44,40 @@ inline spdlog::async_logger::async_logger(
 {
 }
 
+// messages in the queue point to this logger - wait until the thread pool is done with them
+inline spdlog::async_logger::~async_logger()
+{
+    try
+    {
+        bool processed = false;
+        {
+            details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+            if (auto pool_ptr = pool.get())
+            {
+                processed = pool_ptr->wait_processed();
+            }
+        }
+        if (!processed && thread_pool_stopped_.valid())
+        {
+            // the pool is being drained or destroyed (and drains the queue), or is gone already
+            thread_pool_stopped_.wait();
+        }
+    }
+    catch (...)
+    {
+    }
+}
+
 // send the log message to the thread pool
 inline void spdlog::async_logger::sink_it_(details::log_msg &msg)
 {
 #if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
     incr_msg_counter_(msg);
 #endif
-    if (auto pool_ptr = thread_pool_.lock())
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
     {
-        pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
+        pool_ptr->post_log(this, msg, overflow_policy_);
     }
     else
     {
@@ -51,12 +85,106 @@ inline void spdlog::async_logger::sink_it_(details::log_msg &msg)
     }
 }
 
+// send the captured arguments to the thread pool, to be formatted there
+inline void spdlog::async_logger::sink_it_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+#if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
+    incr_msg_counter_(msg);
+#endif
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
+    {
+        pool_ptr->post_log(this, msg, overflow_policy_, format_fn);
+    }
+    else
+    {
+        throw spdlog_ex("async log: thread pool doesn't exist anymore");
+    }
+}
+
+inline void spdlog::async_logger::set_deferred_formatting(bool enabled)
+{
+    defer_formatting_.store(enabled, std::memory_order_relaxed);
+}
+
+inline bool spdlog::async_logger::deferred_formatting() const
+{
+    return defer_formatting_.load(std::memory_order_relaxed);
+}
+
+inline void spdlog::async_logger::set_shard(size_t shard)
+{
+    shard_.store(shard, std::memory_order_relaxed);
+}
+
+inline size_t spdlog::async_logger::shard() const
+{
+    return shard_.load(std::memory_order_relaxed);
+}
+
+inline size_t spdlog::async_logger::overrun_counter() const
+{
+    return overruns_.load(std::memory_order_relaxed);
+}
+
+inline void spdlog::async_logger::set_block_timeout(std::chrono::milliseconds timeout)
+{
+    block_timeout_.store(timeout.count(), std::memory_order_relaxed);
+}
+
+inline std::chrono::milliseconds spdlog::async_logger::block_timeout() const
+{
+    return std::chrono::milliseconds(block_timeout_.load(std::memory_order_relaxed));
+}
+
+inline void spdlog::async_logger::set_quota(size_t max_in_flight)
+{
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
+    {
+        pool_ptr->set_quota(name_, max_in_flight);
+        quota_.store(pool_ptr->quota(name_), std::memory_order_relaxed);
+    }
+    else
+    {
+        throw spdlog_ex("async quota: thread pool doesn't exist anymore");
+    }
+}
+
+inline void spdlog::async_logger::set_quota_group(const std::string &group)
+{
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
+    {
+        quota_.store(group.empty() ? nullptr : pool_ptr->quota(group), std::memory_order_relaxed);
+    }
+    else
+    {
+        throw spdlog_ex("async quota: thread pool doesn't exist anymore");
+    }
+}
+
 // send flush request to the thread pool
 inline void spdlog::async_logger::flush_()
 {
-    if (auto pool_ptr = thread_pool_.lock())
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
     {
-        pool_ptr->post_flush(shared_from_this(), overflow_policy_);
+        pool_ptr->post_flush(this, overflow_policy_);
+    }
+    else
+    {
+        throw spdlog_ex("async flush: thread pool doesn't exist anymore");
+    }
+}
+
+// send flush request to the thread pool, which sets flushed once done
+inline void spdlog::async_logger::flush_with_future_(std::unique_ptr<std::promise<void>> flushed)
+{
+    details::pool_guard<details::thread_pool> pool(thread_pool_ptr_, thread_pool_);
+    if (auto pool_ptr = pool.get())
+    {
+        pool_ptr->post_flush(this, overflow_policy_, std::move(flushed));
     }
     else
     {
@@ -66,25 +194,66 @@ inline void spdlog::async_logger::flush_()
 
 //
 // backend functions - called from the thread pool to do the actual job
+// (the thread pool decides when to call backend_flush_() according to the flush level)
 //
 inline void spdlog::async_logger::backend_log_(const details::log_msg &incoming_log_msg)
 {
     try
     {
+        // sinks with equivalent formatters share the formatted text
+        details::shared_format shared(incoming_log_msg);
         for (auto &s : sinks_)
         {
             if (s->should_log(incoming_log_msg.level))
             {
-                s->log(incoming_log_msg);
+                s->log_shared(incoming_log_msg, shared);
+            }
+        }
+    }
+    SPDLOG_CATCH_AND_HANDLE
+}
+
+// log a run of messages - sinks that accept all of them get them as a single batch
+inline void spdlog::async_logger::backend_log_batch_(const details::log_msg *incoming_log_msgs, size_t count)
+{
+    auto min_level = level::off;
+    for (size_t i = 0; i < count; i++)
+    {
+        min_level = std::min(min_level, incoming_log_msgs[i].level);
+    }
+
+    try
+    {
+        for (auto &s : sinks_)
+        {
+            if (s->should_log(min_level))
+            {
+                s->log_batch(incoming_log_msgs, count);
+                continue;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if (s->should_log(incoming_log_msgs[i].level))
+                {
+                    s->log(incoming_log_msgs[i]);
+                }
             }
         }
     }
     SPDLOG_CATCH_AND_HANDLE
+}
 
-    if (should_flush_(incoming_log_msg))
+// format the captured arguments of a deferred log call.
+// return false if formatting failed (the error handler was called)
+inline bool spdlog::async_logger::backend_format_(details::async_msg &incoming_async_msg, fmt::memory_buffer &buf)
+{
+    try
     {
-        backend_flush_();
+        incoming_async_msg.format_deferred(buf);
+        return true;
     }
+    SPDLOG_CATCH_AND_HANDLE
+    return false;
 }
 
 inline void spdlog::async_logger::backend_flush_()
@@ -106,5 +275,9 @@ inline std::shared_ptr<spdlog::logger> spdlog::async_logger::clone(std::string n
     cloned->set_level(this->level());
     cloned->flush_on(this->flush_level());
     cloned->set_error_handler(this->error_handler());
+    cloned->set_deferred_formatting(this->deferred_formatting());
+    cloned->set_shard(this->shard());
+    cloned->set_block_timeout(this->block_timeout());
+    cloned->quota_.store(quota_.load(std::memory_order_relaxed), std::memory_order_relaxed);
     return std::move(cloned);
 }
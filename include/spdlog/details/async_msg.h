@@ -0,0 +1,158 @@
+#pragma once
+
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#include "spdlog/details/deferred_args.h"
+#include "spdlog/details/fmt_helper.h"
+#include "spdlog/details/log_msg.h"
+#include "spdlog/details/os.h"
+
+#include <future>
+#include <memory>
+
+namespace spdlog {
+class async_logger;
+
+namespace details {
+class async_quota;
+
+// the logger of a message.
+// a plain pointer - the logger's destructor waits until the thread pool is done with its messages.
+using async_logger_ptr = spdlog::async_logger *;
+
+enum class async_msg_type
+{
+    log,
+    flush,
+    terminate,
+    barrier
+};
+
+// Async msg to move to/from the queue
+// Movable only. should never be copied
+struct async_msg
+{
+    async_msg_type msg_type;
+    level::level_enum level;
+    log_clock::time_point time;
+    size_t thread_id;
+    fmt::basic_memory_buffer<char, 176> raw;
+
+    size_t msg_id;
+    source_loc source;
+    async_logger_ptr worker_ptr = nullptr;
+    // if set, raw holds the captured arguments of the log call instead of the formatted message
+    deferred_format_fn deferred_fn = nullptr;
+    // log messages only: the quota whose slot the message holds (see async_quota.h)
+    async_quota *quota = nullptr;
+    // flush messages only: set once the logger's sinks were flushed (see logger::flush_with_future())
+    std::unique_ptr<std::promise<void>> flushed;
+
+    async_msg() = default;
+    ~async_msg() = default;
+
+    // should only be moved in or out of the queue..
+    async_msg(const async_msg &) = delete;
+
+// support for vs2013 move
+#if defined(_MSC_VER) && _MSC_VER <= 1800
+    async_msg(async_msg &&other) SPDLOG_NOEXCEPT : msg_type(other.msg_type),
+                                                   level(other.level),
+                                                   time(other.time),
+                                                   thread_id(other.thread_id),
+                                                   raw(move(other.raw)),
+                                                   msg_id(other.msg_id),
+                                                   source(other.source),
+                                                   worker_ptr(other.worker_ptr),
+                                                   deferred_fn(other.deferred_fn),
+                                                   quota(other.quota),
+                                                   flushed(std::move(other.flushed))
+    {
+    }
+
+    async_msg &operator=(async_msg &&other) SPDLOG_NOEXCEPT
+    {
+        msg_type = other.msg_type;
+        level = other.level;
+        time = other.time;
+        thread_id = other.thread_id;
+        raw = std::move(other.raw);
+        msg_id = other.msg_id;
+        source = other.source;
+        worker_ptr = other.worker_ptr;
+        deferred_fn = other.deferred_fn;
+        quota = other.quota;
+        flushed = std::move(other.flushed);
+        return *this;
+    }
+#else // (_MSC_VER) && _MSC_VER <= 1800
+    async_msg(async_msg &&) = default;
+    async_msg &operator=(async_msg &&) = default;
+#endif
+
+    // construct from log_msg with given type
+    async_msg(async_logger_ptr worker, async_msg_type the_type, details::log_msg &m, deferred_format_fn format_fn = nullptr,
+        async_quota *the_quota = nullptr)
+        : msg_type(the_type)
+        , level(m.level)
+        , time(m.time)
+        , thread_id(m.thread_id)
+        , msg_id(m.msg_id)
+        , source(m.source)
+        , worker_ptr(worker)
+        , deferred_fn(format_fn)
+        , quota(the_quota)
+    {
+        fmt_helper::append_string_view(m.payload, raw);
+    }
+
+    // control messages are stamped too, so queues that order by time keep them
+    // after the messages posted before them.
+    async_msg(async_logger_ptr worker, async_msg_type the_type)
+        : msg_type(the_type)
+        , level(level::off)
+        , time(os::now())
+        , thread_id(0)
+        , msg_id(0)
+        , source()
+        , worker_ptr(worker)
+    {
+    }
+
+    explicit async_msg(async_msg_type the_type)
+        : async_msg(nullptr, the_type)
+    {
+    }
+
+    // format the captured arguments (if any) and replace them with the result
+    void format_deferred(fmt::memory_buffer &scratch)
+    {
+        if (deferred_fn != nullptr)
+        {
+            scratch.resize(0);
+            deferred_fn(raw.data(), scratch);
+            raw.resize(0);
+            fmt_helper::append_buf(scratch, raw);
+            deferred_fn = nullptr;
+        }
+    }
+
+    // copy into log_msg
+    log_msg to_log_msg()
+    {
+        log_msg msg(&worker_ptr->name(), level, string_view_t(raw.data(), raw.size()));
+        msg.time = time;
+        msg.thread_id = thread_id;
+        msg.msg_id = msg_id;
+        msg.source = source;
+        msg.color_range_start = 0;
+        msg.color_range_end = 0;
+        return msg;
+    }
+};
+
+} // namespace details
+} // namespace spdlog
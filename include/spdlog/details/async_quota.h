@@ -0,0 +1,144 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// in-flight limit of a group of async loggers (see thread_pool::set_quota(..)).
+// each log message takes a slot when posted, and gives it back once processed or dropped.
+// the thread pool owns its quotas, so the messages in its queues may point to them.
+
+#include "spdlog/common.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace spdlog {
+namespace details {
+
+class async_quota
+{
+public:
+    explicit async_quota(size_t max_in_flight)
+        : max_in_flight_(max_in_flight)
+    {
+    }
+
+    async_quota(const async_quota &) = delete;
+    async_quota &operator=(const async_quota &) = delete;
+
+    // 0 for no limit. producers waiting for a slot see the new limit right away.
+    void set_max_in_flight(size_t max_in_flight)
+    {
+        max_in_flight_.store(max_in_flight, std::memory_order_relaxed);
+        notify_();
+    }
+
+    size_t max_in_flight() const
+    {
+        return max_in_flight_.load(std::memory_order_relaxed);
+    }
+
+    size_t in_flight() const
+    {
+        return in_flight_.load(std::memory_order_relaxed);
+    }
+
+    // messages dropped because the group had no slot left
+    size_t rejected() const
+    {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+    // take a slot, waiting for one if needed
+    void acquire()
+    {
+        if (!try_acquire_())
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cv_.wait(lock, [this] { return this->try_acquire_(); });
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // take a slot, waiting up to timeout for one. return false (and count the message as
+    // rejected) if there was none.
+    bool acquire_for(std::chrono::milliseconds timeout)
+    {
+        bool acquired = try_acquire_();
+        if (!acquired)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            acquired = cv_.wait_for(lock, timeout, [this] { return this->try_acquire_(); });
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return count_rejected_(acquired);
+    }
+
+    // take a slot if there is one. return false (and count the message as rejected) if not.
+    bool try_acquire()
+    {
+        return count_rejected_(try_acquire_());
+    }
+
+    void release(size_t n)
+    {
+        in_flight_.fetch_sub(n, std::memory_order_relaxed);
+        notify_();
+    }
+
+private:
+    bool count_rejected_(bool acquired)
+    {
+        if (!acquired)
+        {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return acquired;
+    }
+
+    bool try_acquire_()
+    {
+        size_t in_flight = in_flight_.load(std::memory_order_relaxed);
+        do
+        {
+            size_t max_in_flight = max_in_flight_.load(std::memory_order_relaxed);
+            if (max_in_flight != 0 && in_flight >= max_in_flight)
+            {
+                return false;
+            }
+        } while (!in_flight_.compare_exchange_weak(in_flight, in_flight + 1, std::memory_order_relaxed));
+        return true;
+    }
+
+    // same protocol as the doorbell of thread_pool: either the waiting producer sees the
+    // released slot, or we see it waiting and wake it up.
+    void notify_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            cv_.notify_all();
+        }
+    }
+
+    std::atomic<size_t> max_in_flight_;
+    std::atomic<size_t> in_flight_{0};
+    std::atomic<size_t> rejected_{0};
+    std::atomic<size_t> waiting_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,515 @@
+#pragma once
+
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// multi producer-multi consumer blocking queue of async messages, stored as
+// variable length records in a contiguous byte ring (sized in bytes, not items).
+// each record is a fixed header followed by the payload, so short messages take
+// little room and long ones never need a heap allocation.
+// a record that doesn't fit before the end of the ring starts over at its beginning.
+// enqueue(..) - will block until room found to put the new message.
+// enqueue_nowait(..) - will overrun the oldest messages if no room left in the queue.
+// enqueue_for(..) - will block up to a timeout until room found, then give up.
+// try_enqueue(..) - will give up right away if no room left in the queue.
+// enqueue_bulk(..) - same as enqueue(..) for several messages, under a single lock.
+// a message that wasn't enqueued is dropped (a flush's promise is broken).
+// dequeue_for(..) - will block until the queue is not empty or timeout have
+// passed.
+// dequeue_bulk_for(..) - same as dequeue_for(..), but pops up to max_items
+// items under a single lock.
+// a zero timeout makes dequeue_for(..) and dequeue_bulk_for(..) return right away.
+// the enqueue functions throw spdlog_ex if the message is larger than the whole ring.
+
+#include "spdlog/common.h"
+#include "spdlog/details/async_msg.h"
+#include "spdlog/details/queue_storage.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace spdlog {
+namespace details {
+
+class byte_ring_blocking_queue
+{
+public:
+    using item_type = async_msg;
+
+    // max_bytes is raised to min_bytes, so a tiny size can't make every message too large
+    explicit byte_ring_blocking_queue(size_t max_bytes, const async_queue_memory &memory = async_queue_memory())
+        : capacity_(capacity_for_(max_bytes))
+        , buffer_(capacity_, memory)
+    {
+    }
+
+    byte_ring_blocking_queue(const byte_ring_blocking_queue &) = delete;
+    byte_ring_blocking_queue &operator=(const byte_ring_blocking_queue &) = delete;
+
+    ~byte_ring_blocking_queue()
+    {
+        while (head_ != tail_)
+        {
+            discard_front_();
+        }
+    }
+
+    // try to enqueue and block if no room left.
+    // on_wait(duration) is called with the time it was blocked (if it was).
+    template<typename OnWait = no_queue_hook>
+    void enqueue(async_msg &&item, OnWait on_wait = OnWait())
+    {
+        push_(header_from_(item), string_view_t(item.raw.data(), item.raw.size()), push_mode::block, on_wait, no_queue_hook());
+    }
+
+    // try to enqueue and block up to timeout if no room left. return false if it timed out.
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(async_msg &&item, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        return push_(header_from_(item), string_view_t(item.raw.data(), item.raw.size()), push_mode::block_for, on_wait,
+            no_queue_hook(), timeout);
+    }
+
+    // enqueue if there is room. return false if not - without taking the lock if the queue
+    // is known to be too full.
+    bool try_enqueue(async_msg &&item)
+    {
+        return push_(
+            header_from_(item), string_view_t(item.raw.data(), item.raw.size()), push_mode::try_once, no_queue_hook(), no_queue_hook());
+    }
+
+    // enqueue immediately. overrun oldest messages in the queue if no room left.
+    // on_overrun(worker_ptr, msg_type, quota) is called (under the queue's lock) for each overrun
+    // message - the messages themselves are not rebuilt for it.
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(async_msg &&item, OnOverrun on_overrun = OnOverrun())
+    {
+        push_(header_from_(item), string_view_t(item.raw.data(), item.raw.size()), push_mode::overrun, no_queue_hook(), on_overrun);
+    }
+
+    // enqueue the messages in order under a single lock (unless it has to wait for room).
+    template<typename OnWait = no_queue_hook>
+    void enqueue_bulk(async_msg *items, size_t n, OnWait on_wait = OnWait())
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto waited = queue_wait_clock::duration::zero();
+        for (size_t i = 0; i < n; i++)
+        {
+            auto &item = items[i];
+            auto payload = string_view_t(item.raw.data(), item.raw.size());
+            auto header = header_from_(item);
+            size_t record_size = record_size_for_(header, payload);
+            if (needed_for_(record_size) > free_bytes_())
+            {
+                if (waiting_consumers_ > 0)
+                {
+                    // let consumers take the records pushed so far before waiting for them
+                    push_cv_.notify_all();
+                }
+                auto wait_start = queue_wait_clock::now();
+                waiting_producers_++;
+                pop_cv_.wait(lock, [this, record_size] { return this->needed_for_(record_size) <= this->free_bytes_(); });
+                waiting_producers_--;
+                waited += queue_wait_clock::now() - wait_start;
+            }
+            write_record_(std::move(header), payload, record_size);
+        }
+        if (waiting_consumers_ > 0)
+        {
+            push_cv_.notify_all();
+        }
+        lock.unlock();
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+    }
+
+    // same as above, but serialize straight from the log_msg (its payload is copied once, into the ring)
+    // (quota: see async_msg::quota)
+    template<typename OnWait = no_queue_hook>
+    void enqueue(async_logger_ptr worker, async_msg_type msg_type, const log_msg &msg, deferred_format_fn deferred_fn = nullptr,
+        async_quota *quota = nullptr, OnWait on_wait = OnWait())
+    {
+        push_(header_from_(worker, msg_type, msg, deferred_fn, quota), msg.payload, push_mode::block, on_wait, no_queue_hook());
+    }
+
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(async_logger_ptr worker, async_msg_type msg_type, const log_msg &msg, deferred_format_fn deferred_fn,
+        async_quota *quota, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        return push_(
+            header_from_(worker, msg_type, msg, deferred_fn, quota), msg.payload, push_mode::block_for, on_wait, no_queue_hook(), timeout);
+    }
+
+    bool try_enqueue(async_logger_ptr worker, async_msg_type msg_type, const log_msg &msg, deferred_format_fn deferred_fn = nullptr,
+        async_quota *quota = nullptr)
+    {
+        return push_(
+            header_from_(worker, msg_type, msg, deferred_fn, quota), msg.payload, push_mode::try_once, no_queue_hook(), no_queue_hook());
+    }
+
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(async_logger_ptr worker, async_msg_type msg_type, const log_msg &msg, deferred_format_fn deferred_fn = nullptr,
+        async_quota *quota = nullptr, OnOverrun on_overrun = OnOverrun())
+    {
+        push_(header_from_(worker, msg_type, msg, deferred_fn, quota), msg.payload, push_mode::overrun, no_queue_hook(), on_overrun);
+    }
+
+    // try to dequeue item. if no item found. wait upto timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(async_msg &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        return dequeue_bulk_for(&popped_item, 1, wait_duration) == 1;
+    }
+
+    // try to dequeue up to max_items items. if no item found. wait upto timeout and try again
+    // Return the number of dequeued items (0 if timed out)
+    size_t dequeue_bulk_for(async_msg *popped_items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        size_t popped = 0;
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (head_ == tail_)
+            {
+                if (wait_duration <= std::chrono::milliseconds::zero())
+                {
+                    return 0;
+                }
+                waiting_consumers_++;
+                bool has_item = push_cv_.wait_for(lock, wait_duration, [this] { return this->head_ != this->tail_; });
+                waiting_consumers_--;
+                if (!has_item)
+                {
+                    return 0;
+                }
+            }
+            while (popped < max_items && head_ != tail_)
+            {
+                pop_front_(popped_items[popped++]);
+            }
+            free_bytes_hint_.store(free_bytes_(), std::memory_order_relaxed);
+            notify = waiting_producers_ > 0;
+        }
+        if (!notify)
+        {
+            return popped;
+        }
+        if (popped > 1)
+        {
+            pop_cv_.notify_all();
+        }
+        else
+        {
+            pop_cv_.notify_one();
+        }
+        return popped;
+    }
+
+    size_t overrun_counter()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return overrun_counter_;
+    }
+
+private:
+    struct record_header
+    {
+        size_t record_size; // header + payload + padding
+        size_t payload_size;
+        bool skip;          // marks the unused end of the ring
+        async_msg_type msg_type;
+        level::level_enum level;
+        log_clock::time_point time;
+        size_t thread_id;
+        size_t msg_id;
+        source_loc source;
+        async_logger_ptr worker_ptr;
+        deferred_format_fn deferred_fn;
+        async_quota *quota;
+        std::promise<void> *flushed; // owned by the record
+    };
+
+    static const size_t record_align = alignof(record_header);
+    static const size_t min_bytes = 1024;
+    static const size_t header_size = (sizeof(record_header) + record_align - 1) / record_align * record_align;
+
+    static size_t capacity_for_(size_t max_bytes)
+    {
+        if (max_bytes < min_bytes)
+        {
+            max_bytes = min_bytes;
+        }
+        return max_bytes / record_align * record_align;
+    }
+
+    static record_header header_from_(async_msg &item)
+    {
+        record_header header{};
+        header.msg_type = item.msg_type;
+        header.level = item.level;
+        header.time = item.time;
+        header.thread_id = item.thread_id;
+        header.msg_id = item.msg_id;
+        header.source = item.source;
+        header.worker_ptr = item.worker_ptr;
+        header.deferred_fn = item.deferred_fn;
+        header.quota = item.quota;
+        header.flushed = item.flushed.release();
+        return header;
+    }
+
+    static record_header header_from_(
+        async_logger_ptr worker, async_msg_type msg_type, const log_msg &msg, deferred_format_fn deferred_fn, async_quota *quota)
+    {
+        record_header header{};
+        header.msg_type = msg_type;
+        header.level = msg.level;
+        header.time = msg.time;
+        header.thread_id = msg.thread_id;
+        header.msg_id = msg.msg_id;
+        header.source = msg.source;
+        header.worker_ptr = worker;
+        header.deferred_fn = deferred_fn;
+        header.quota = quota;
+        return header;
+    }
+
+    // bytes between position pos and the end of the ring
+    size_t contiguous_from_(size_t pos) const
+    {
+        return capacity_ - pos % capacity_;
+    }
+
+    record_header *header_at_(size_t pos)
+    {
+        return reinterpret_cast<record_header *>(buffer_.data() + pos % capacity_);
+    }
+
+    // bytes needed at the tail to put a record of the given size - including the end of
+    // the ring which is wasted if the record doesn't fit there.
+    size_t needed_for_(size_t record_size) const
+    {
+        auto contiguous = contiguous_from_(tail_);
+        return contiguous < record_size ? contiguous + record_size : record_size;
+    }
+
+    // what push_(..) does if there is no room for the record
+    enum class push_mode
+    {
+        block,     // wait for room
+        block_for, // wait up to a timeout, then give up
+        try_once,  // give up
+        overrun    // discard the oldest records
+    };
+
+    // set the header's sizes and return the size of its record. throw if it can never fit.
+    size_t record_size_for_(record_header &header, string_view_t payload)
+    {
+        size_t record_size = (header_size + payload.size() + record_align - 1) / record_align * record_align;
+        if (record_size > capacity_)
+        {
+            delete header.flushed;
+            throw spdlog_ex("async log: message is larger than the async queue");
+        }
+        header.record_size = record_size;
+        header.payload_size = payload.size();
+        return record_size;
+    }
+
+    // put the record at the tail. under the lock, once there is room for it.
+    void write_record_(record_header &&header, string_view_t payload, size_t record_size)
+    {
+        auto contiguous = contiguous_from_(tail_);
+        if (contiguous < record_size)
+        {
+            if (contiguous >= header_size)
+            {
+                auto *skip_header = new (header_at_(tail_)) record_header{};
+                skip_header->record_size = contiguous;
+                skip_header->skip = true;
+            }
+            tail_ += contiguous;
+        }
+
+        auto *record = new (header_at_(tail_)) record_header(std::move(header));
+        std::memcpy(reinterpret_cast<char *>(record) + header_size, payload.data(), payload.size());
+        tail_ += record_size;
+        free_bytes_hint_.store(free_bytes_(), std::memory_order_relaxed);
+    }
+
+    // return false if the record was given up (and the header's flush promise broken)
+    template<typename OnWait, typename OnOverrun>
+    bool push_(record_header &&header, string_view_t payload, push_mode mode, OnWait on_wait, OnOverrun on_overrun,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds::zero())
+    {
+        size_t record_size = record_size_for_(header, payload);
+
+        // fast check without the lock (the exact one below also accounts for the end of the ring)
+        if (mode == push_mode::try_once && record_size > free_bytes_hint_.load(std::memory_order_relaxed))
+        {
+            delete header.flushed;
+            return false;
+        }
+
+        bool notify;
+        auto waited = queue_wait_clock::duration::zero();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (needed_for_(record_size) > free_bytes_())
+            {
+                auto has_room = [this, record_size] { return this->needed_for_(record_size) <= this->free_bytes_(); };
+                bool pushable = true;
+                switch (mode)
+                {
+                case push_mode::block:
+                case push_mode::block_for:
+                {
+                    auto wait_start = queue_wait_clock::now();
+                    waiting_producers_++;
+                    if (mode == push_mode::block)
+                    {
+                        pop_cv_.wait(lock, has_room);
+                    }
+                    else
+                    {
+                        pushable = pop_cv_.wait_for(lock, timeout, has_room);
+                    }
+                    waiting_producers_--;
+                    waited = queue_wait_clock::now() - wait_start;
+                    break;
+                }
+                case push_mode::try_once:
+                    pushable = false;
+                    break;
+                case push_mode::overrun:
+                    while (!has_room())
+                    {
+                        skip_to_record_();
+                        auto *dropped = header_at_(head_);
+                        on_overrun(static_cast<const async_logger_ptr &>(dropped->worker_ptr), dropped->msg_type, dropped->quota);
+                        discard_front_();
+                        ++overrun_counter_;
+                    }
+                    break;
+                }
+                if (!pushable)
+                {
+                    lock.unlock();
+                    delete header.flushed;
+                    if (waited != queue_wait_clock::duration::zero())
+                    {
+                        on_wait(waited);
+                    }
+                    return false;
+                }
+            }
+
+            write_record_(std::move(header), payload, record_size);
+            notify = waiting_consumers_ > 0;
+        }
+        if (notify)
+        {
+            push_cv_.notify_one();
+        }
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+        return true;
+    }
+
+    size_t free_bytes_() const
+    {
+        return capacity_ - (tail_ - head_);
+    }
+
+    // step over the unused end of the ring (if head_ is there)
+    void skip_to_record_()
+    {
+        auto contiguous = contiguous_from_(head_);
+        if (contiguous < header_size)
+        {
+            head_ += contiguous;
+            return;
+        }
+        auto *header = header_at_(head_);
+        if (header->skip)
+        {
+            header->~record_header();
+            head_ += contiguous;
+        }
+    }
+
+    // release the room of the record at head_. when the ring becomes empty, start over at its beginning.
+    void advance_head_(size_t record_size)
+    {
+        head_ += record_size;
+        if (head_ == tail_)
+        {
+            head_ = tail_ = 0;
+        }
+    }
+
+    void pop_front_(async_msg &popped_item)
+    {
+        skip_to_record_();
+        auto *header = header_at_(head_);
+        auto record_size = header->record_size;
+        popped_item.msg_type = header->msg_type;
+        popped_item.level = header->level;
+        popped_item.time = header->time;
+        popped_item.thread_id = header->thread_id;
+        popped_item.msg_id = header->msg_id;
+        popped_item.source = header->source;
+        popped_item.worker_ptr = header->worker_ptr;
+        popped_item.deferred_fn = header->deferred_fn;
+        popped_item.quota = header->quota;
+        popped_item.flushed.reset(header->flushed);
+        // the popped item's buffer is reused - no allocation once it grew to the largest payload
+        const char *payload = reinterpret_cast<const char *>(header) + header_size;
+        popped_item.raw.resize(0);
+        popped_item.raw.append(payload, payload + header->payload_size);
+        header->~record_header();
+        advance_head_(record_size);
+    }
+
+    void discard_front_()
+    {
+        skip_to_record_();
+        auto *header = header_at_(head_);
+        auto record_size = header->record_size;
+        // the flush never happens - its waiter gets a broken promise
+        delete header->flushed;
+        header->~record_header();
+        advance_head_(record_size);
+    }
+
+    const size_t capacity_;
+    queue_storage<char> buffer_;
+
+    // byte offsets (modulo capacity_) of the oldest record and of the end of the newest one
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    // free_bytes_() as of the last push or pop - read without the lock by try_enqueue(..)
+    std::atomic<size_t> free_bytes_hint_{capacity_};
+
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    // let each side skip notifying the other when nobody waits
+    size_t waiting_consumers_ = 0;
+    size_t waiting_producers_ = 0;
+    size_t overrun_counter_ = 0;
+};
+} // namespace details
+} // namespace spdlog
@@ -3,10 +3,10 @@
 // Distributed under the MIT License (http://opensource.org/licenses/MIT)
 //
 
-// cirucal q view of std::vector.
+// cirucal q view of a queue_storage.
 #pragma once
 
-#include <vector>
+#include "spdlog/details/queue_storage.h"
 
 namespace spdlog {
 namespace details {
@@ -16,20 +16,23 @@ class circular_q
 public:
     using item_type = T;
 
-    explicit circular_q(size_t max_items)
+    explicit circular_q(size_t max_items, const async_queue_memory &memory = async_queue_memory())
         : max_items_(max_items + 1) // one item is reserved as marker for full q
-        , v_(max_items_)
+        , v_(max_items_, memory)
     {
     }
 
-    // push back, overrun (oldest) item if no room left
-    void push_back(T &&item)
+    // push back, overrun (oldest) item if no room left.
+    // on_overrun(item) is called with the overrun item.
+    template<typename OnOverrun = no_queue_hook>
+    void push_back(T &&item, OnOverrun on_overrun = OnOverrun())
     {
         v_[tail_] = std::move(item);
         tail_ = (tail_ + 1) % max_items_;
 
         if (tail_ == head_) // overrun last item if full
         {
+            on_overrun(static_cast<const T &>(v_[head_]));
             head_ = (head_ + 1) % max_items_;
             ++overrun_counter_;
         }
@@ -61,10 +64,10 @@ public:
 
 private:
     size_t max_items_;
-    typename std::vector<T>::size_type head_ = 0;
-    typename std::vector<T>::size_type tail_ = 0;
+    size_t head_ = 0;
+    size_t tail_ = 0;
 
-    std::vector<T> v_;
+    queue_storage<T> v_;
 
     size_t overrun_counter_ = 0;
 };
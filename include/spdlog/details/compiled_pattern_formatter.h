@@ -0,0 +1,285 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// pattern formatter for patterns known at compile time.
+// the pattern is parsed by the compiler into a tuple of appenders - the flag formatters of
+// pattern_formatter, called without virtual dispatch, and the literal runs between them.
+// the output is the same as pattern_formatter's for the same pattern.
+//
+// e.g.
+// SPDLOG_COMPILED_PATTERN(my_pattern, "[%H:%M:%S.%e] [%l] %v");
+// sink->set_formatter(spdlog::details::make_unique<spdlog::compiled_pattern_formatter<my_pattern>>());
+
+#include "spdlog/details/pattern_formatter.h"
+
+#include <tuple>
+#include <type_traits>
+
+// declare a pattern type for compiled_pattern_formatter
+#define SPDLOG_COMPILED_PATTERN(name, pattern)                                                                                             \
+    struct name                                                                                                                            \
+    {                                                                                                                                      \
+        static constexpr const char *value()                                                                                               \
+        {                                                                                                                                  \
+            return pattern;                                                                                                                \
+        }                                                                                                                                  \
+    }
+
+namespace spdlog {
+namespace details {
+namespace compiled {
+
+// the chars of a literal run of the pattern
+template<typename Pattern, size_t Begin, size_t End>
+struct literal_appender
+{
+    void format(const log_msg &, const std::tm &, fmt::memory_buffer &dest)
+    {
+        fmt_helper::append_string_view(string_view_t(Pattern::value() + Begin, End - Begin), dest);
+    }
+};
+
+template<char... Chars>
+struct chars_appender
+{
+    void format(const log_msg &, const std::tm &, fmt::memory_buffer &dest)
+    {
+        const char chars[] = {Chars...};
+        dest.append(chars, chars + sizeof...(Chars));
+    }
+};
+
+template<typename Formatter, padding_info::pad_side Side, size_t Width>
+struct flag_appender
+{
+    Formatter formatter{padding_info{Width, Side}};
+
+    void format(const log_msg &msg, const std::tm &tm_time, fmt::memory_buffer &dest)
+    {
+        formatter.Formatter::format(msg, tm_time, dest);
+    }
+};
+
+// the flag formatter of each flag (see pattern_formatter::handle_flag_(..))
+template<char Flag>
+struct flag_formatter_of
+{
+    using type = void; // unknown flag
+};
+
+#define SPDLOG_FLAG_FORMATTER(flag, formatter_type)                                                                                        \
+    template<>                                                                                                                             \
+    struct flag_formatter_of<flag>                                                                                                         \
+    {                                                                                                                                      \
+        using type = formatter_type;                                                                                                       \
+    };
+
+SPDLOG_FLAG_FORMATTER('+', full_formatter)
+SPDLOG_FLAG_FORMATTER('n', name_formatter)
+SPDLOG_FLAG_FORMATTER('l', level_formatter)
+SPDLOG_FLAG_FORMATTER('L', short_level_formatter)
+SPDLOG_FLAG_FORMATTER('t', t_formatter)
+SPDLOG_FLAG_FORMATTER('v', v_formatter)
+SPDLOG_FLAG_FORMATTER('a', a_formatter)
+SPDLOG_FLAG_FORMATTER('A', A_formatter)
+SPDLOG_FLAG_FORMATTER('b', b_formatter)
+SPDLOG_FLAG_FORMATTER('h', b_formatter)
+SPDLOG_FLAG_FORMATTER('B', B_formatter)
+SPDLOG_FLAG_FORMATTER('c', c_formatter)
+SPDLOG_FLAG_FORMATTER('C', C_formatter)
+SPDLOG_FLAG_FORMATTER('Y', Y_formatter)
+SPDLOG_FLAG_FORMATTER('D', D_formatter)
+SPDLOG_FLAG_FORMATTER('x', D_formatter)
+SPDLOG_FLAG_FORMATTER('m', m_formatter)
+SPDLOG_FLAG_FORMATTER('d', d_formatter)
+SPDLOG_FLAG_FORMATTER('H', H_formatter)
+SPDLOG_FLAG_FORMATTER('I', I_formatter)
+SPDLOG_FLAG_FORMATTER('M', M_formatter)
+SPDLOG_FLAG_FORMATTER('S', S_formatter)
+SPDLOG_FLAG_FORMATTER('e', e_formatter)
+SPDLOG_FLAG_FORMATTER('f', f_formatter)
+SPDLOG_FLAG_FORMATTER('F', F_formatter)
+SPDLOG_FLAG_FORMATTER('E', E_formatter)
+SPDLOG_FLAG_FORMATTER('p', p_formatter)
+SPDLOG_FLAG_FORMATTER('r', r_formatter)
+SPDLOG_FLAG_FORMATTER('R', R_formatter)
+SPDLOG_FLAG_FORMATTER('T', T_formatter)
+SPDLOG_FLAG_FORMATTER('X', T_formatter)
+SPDLOG_FLAG_FORMATTER('z', z_formatter)
+SPDLOG_FLAG_FORMATTER('P', pid_formatter)
+#ifdef SPDLOG_ENABLE_MESSAGE_COUNTER
+SPDLOG_FLAG_FORMATTER('i', i_formatter)
+#endif
+SPDLOG_FLAG_FORMATTER('^', color_start_formatter)
+SPDLOG_FLAG_FORMATTER('$', color_stop_formatter)
+SPDLOG_FLAG_FORMATTER('@', source_location_formatter)
+SPDLOG_FLAG_FORMATTER('s', source_filename_formatter)
+SPDLOG_FLAG_FORMATTER('#', source_linenum_formatter)
+
+#undef SPDLOG_FLAG_FORMATTER
+
+// unknown flags appear as is (padding dropped), and %% as a single %
+template<char Flag, padding_info::pad_side Side, size_t Width>
+struct flag_element
+{
+    using formatter_type = typename flag_formatter_of<Flag>::type;
+    using type = typename std::conditional<std::is_void<formatter_type>::value, chars_appender<'%', Flag>,
+        flag_appender<formatter_type, Side, Width>>::type;
+};
+
+template<padding_info::pad_side Side, size_t Width>
+struct flag_element<'%', Side, Width>
+{
+    using type = chars_appender<'%'>;
+};
+
+// constexpr parsing helpers (see pattern_formatter::handle_padspec_(..))
+constexpr size_t literal_end(const char *pattern, size_t i)
+{
+    return pattern[i] == '\0' || pattern[i] == '%' ? i : literal_end(pattern, i + 1);
+}
+
+constexpr padding_info::pad_side pad_side_at(const char *pattern, size_t i)
+{
+    return pattern[i] == '-' ? padding_info::right : pattern[i] == '=' ? padding_info::center : padding_info::left;
+}
+
+constexpr size_t digits_end(const char *pattern, size_t i)
+{
+    return pattern[i] >= '0' && pattern[i] <= '9' ? digits_end(pattern, i + 1) : i;
+}
+
+constexpr size_t pad_width(const char *pattern, size_t i, size_t end, size_t width)
+{
+    return i == end ? (width < 128 ? width : 128) : pad_width(pattern, i + 1, end, width * 10 + static_cast<size_t>(pattern[i] - '0'));
+}
+
+template<typename Element, typename Tuple>
+struct prepend;
+
+template<typename Element, typename... Elements>
+struct prepend<Element, std::tuple<Elements...>>
+{
+    using type = std::tuple<Element, Elements...>;
+};
+
+// parse the pattern from index I into a tuple of appenders
+template<typename Pattern, size_t I, char Ch = Pattern::value()[I]>
+struct parse;
+
+template<typename Pattern, size_t I, padding_info::pad_side Side, size_t Width, char Flag = Pattern::value()[I]>
+struct parse_flag
+{
+    using type = typename prepend<typename flag_element<Flag, Side, Width>::type, typename parse<Pattern, I + 1>::type>::type;
+};
+
+// the pattern ends in the middle of a flag
+template<typename Pattern, size_t I, padding_info::pad_side Side, size_t Width>
+struct parse_flag<Pattern, I, Side, Width, '\0'>
+{
+    using type = std::tuple<>;
+};
+
+template<typename Pattern, size_t I, char Ch>
+struct parse
+{
+    static constexpr size_t end = literal_end(Pattern::value(), I);
+    using type = typename prepend<literal_appender<Pattern, I, end>, typename parse<Pattern, end>::type>::type;
+};
+
+template<typename Pattern, size_t I>
+struct parse<Pattern, I, '\0'>
+{
+    using type = std::tuple<>;
+};
+
+template<typename Pattern, size_t I>
+struct parse<Pattern, I, '%'>
+{
+    static constexpr padding_info::pad_side side = pad_side_at(Pattern::value(), I + 1);
+    static constexpr size_t digits = side == padding_info::left ? I + 1 : I + 2;
+    static constexpr size_t flag_pos = digits_end(Pattern::value(), digits);
+    using type = typename parse_flag<Pattern, flag_pos, side, pad_width(Pattern::value(), digits, flag_pos, 0)>::type;
+};
+
+} // namespace compiled
+} // namespace details
+
+template<typename Pattern>
+class compiled_pattern_formatter final : public formatter
+{
+public:
+    explicit compiled_pattern_formatter(
+        pattern_time_type time_type = pattern_time_type::local, std::string eol = spdlog::details::os::default_eol)
+        : eol_(std::move(eol))
+        , pattern_time_type_(time_type)
+        , last_log_secs_(0)
+    {
+        std::memset(&cached_tm_, 0, sizeof(cached_tm_));
+    }
+
+    compiled_pattern_formatter(const compiled_pattern_formatter &other) = delete;
+    compiled_pattern_formatter &operator=(const compiled_pattern_formatter &other) = delete;
+
+    std::unique_ptr<formatter> clone() const override
+    {
+        return details::make_unique<compiled_pattern_formatter>(pattern_time_type_, eol_);
+    }
+
+    // the same as pattern_formatter's - their output is the same
+    string_view_t format_key() const override
+    {
+        return key_;
+    }
+
+    void format(const details::log_msg &msg, fmt::memory_buffer &dest) override
+    {
+#ifndef SPDLOG_NO_DATETIME
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+        if (secs != last_log_secs_)
+        {
+            cached_tm_ = get_time_(msg);
+            last_log_secs_ = secs;
+        }
+#endif
+        format_<0>(msg, dest);
+        // write eol
+        details::fmt_helper::append_string_view(eol_, dest);
+    }
+
+private:
+    using appenders = typename details::compiled::parse<Pattern, 0>::type;
+
+    std::string eol_;
+    pattern_time_type pattern_time_type_;
+    std::string key_ = details::pattern_format_key(Pattern::value(), pattern_time_type_, eol_);
+    std::tm cached_tm_;
+    std::chrono::seconds last_log_secs_;
+    appenders appenders_;
+
+    std::tm get_time_(const details::log_msg &msg)
+    {
+        if (pattern_time_type_ == pattern_time_type::local)
+        {
+            return details::local_time::localtime(log_clock::to_time_t(msg.time));
+        }
+        return details::os::gmtime(log_clock::to_time_t(msg.time));
+    }
+
+    template<size_t I>
+    typename std::enable_if<(I < std::tuple_size<appenders>::value)>::type format_(const details::log_msg &msg, fmt::memory_buffer &dest)
+    {
+        std::get<I>(appenders_).format(msg, cached_tm_, dest);
+        format_<I + 1>(msg, dest);
+    }
+
+    template<size_t I>
+    typename std::enable_if<I == std::tuple_size<appenders>::value>::type format_(const details::log_msg &, fmt::memory_buffer &)
+    {
+    }
+};
+} // namespace spdlog
@@ -0,0 +1,220 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// Capture the arguments of a log call into a byte buffer so they can be
+// formatted later (on the async worker) instead of on the calling thread.
+// Only arguments that can be copied into the buffer are supported:
+// arithmetic types and strings (const char*, std::string, string_view_t),
+// which are copied by value so the caller's objects can go away right after the call.
+// Note that char pointers are always formatted as strings.
+//
+// The buffer holds the format string followed by the arguments:
+// [size_t length][chars] for strings, the raw bytes of the value for arithmetic types.
+
+#include "spdlog/common.h"
+#include "spdlog/fmt/fmt.h"
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace spdlog {
+namespace details {
+
+// format the captured arguments in data into dest
+using deferred_format_fn = void (*)(const char *data, fmt::memory_buffer &dest);
+
+namespace deferred {
+
+inline void write_bytes(fmt::memory_buffer &buf, const void *data, size_t size)
+{
+    auto *p = static_cast<const char *>(data);
+    buf.append(p, p + size);
+}
+
+inline void write_string(fmt::memory_buffer &buf, const char *data, size_t size)
+{
+    write_bytes(buf, &size, sizeof(size));
+    write_bytes(buf, data, size);
+}
+
+inline string_view_t read_string(const char *&data)
+{
+    size_t size;
+    std::memcpy(&size, data, sizeof(size));
+    data += sizeof(size);
+    string_view_t view(data, size);
+    data += size;
+    return view;
+}
+
+// how to capture an argument of type T - supported types specialize it
+template<typename T, typename = void>
+struct arg_traits
+{
+    static const bool supported = false;
+};
+
+template<typename T>
+struct arg_traits<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static const bool supported = true;
+
+    static void write(fmt::memory_buffer &buf, const T &value)
+    {
+        write_bytes(buf, &value, sizeof(T));
+    }
+
+    static T read(const char *&data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+};
+
+struct string_arg_traits
+{
+    static const bool supported = true;
+
+    static void write(fmt::memory_buffer &buf, const char *value)
+    {
+        if (value == nullptr)
+        {
+            // same error fmt would report when formatting it
+            throw fmt::format_error("string pointer is null");
+        }
+        write_string(buf, value, std::strlen(value));
+    }
+
+    static void write(fmt::memory_buffer &buf, const std::string &value)
+    {
+        write_string(buf, value.data(), value.size());
+    }
+
+    static void write(fmt::memory_buffer &buf, string_view_t value)
+    {
+        write_string(buf, value.data(), value.size());
+    }
+
+    static string_view_t read(const char *&data)
+    {
+        return read_string(data);
+    }
+};
+
+template<>
+struct arg_traits<const char *> : string_arg_traits
+{
+};
+
+template<>
+struct arg_traits<char *> : string_arg_traits
+{
+};
+
+template<size_t N>
+struct arg_traits<char[N]> : string_arg_traits
+{
+};
+
+template<>
+struct arg_traits<std::string> : string_arg_traits
+{
+};
+
+template<>
+struct arg_traits<string_view_t> : string_arg_traits
+{
+};
+
+template<typename... Args>
+struct all_supported;
+
+template<>
+struct all_supported<>
+{
+    static const bool value = true;
+};
+
+template<typename First, typename... Rest>
+struct all_supported<First, Rest...>
+{
+    static const bool value = arg_traits<First>::supported && all_supported<Rest...>::value;
+};
+
+// read the captured arguments one by one, then format them all
+template<typename... Rest>
+struct decoder;
+
+template<>
+struct decoder<>
+{
+    template<typename... Done>
+    static void format(const char *, string_view_t fmt, fmt::memory_buffer &dest, const Done &... done)
+    {
+        fmt::vformat_to(dest, fmt, fmt::make_format_args(done...));
+    }
+};
+
+template<typename First, typename... Rest>
+struct decoder<First, Rest...>
+{
+    template<typename... Done>
+    static void format(const char *data, string_view_t fmt, fmt::memory_buffer &dest, const Done &... done)
+    {
+        auto value = arg_traits<First>::read(data);
+        decoder<Rest...>::format(data, fmt, dest, done..., value);
+    }
+};
+
+inline void write_args(fmt::memory_buffer &) {}
+
+template<typename First, typename... Rest>
+inline void write_args(fmt::memory_buffer &buf, const First &first, const Rest &... rest)
+{
+    arg_traits<First>::write(buf, first);
+    write_args(buf, rest...);
+}
+
+template<typename... Args>
+struct supported_args
+{
+    static void write(fmt::memory_buffer &buf, const char *fmt, const Args &... args)
+    {
+        write_string(buf, fmt, std::strlen(fmt));
+        write_args(buf, args...);
+    }
+
+    static void format(const char *data, fmt::memory_buffer &dest)
+    {
+        auto fmt = read_string(data);
+        decoder<Args...>::format(data, fmt, dest);
+    }
+};
+
+// never used at runtime - only lets logger::log compile for any argument types
+struct unsupported_args
+{
+    template<typename... Args>
+    static void write(fmt::memory_buffer &, const char *, const Args &...)
+    {
+    }
+
+    static void format(const char *, fmt::memory_buffer &) {}
+};
+} // namespace deferred
+
+template<typename... Args>
+struct deferred_args : std::conditional<deferred::all_supported<Args...>::value, deferred::supported_args<Args...>, deferred::unsupported_args>::type
+{
+    static const bool supported = deferred::all_supported<Args...>::value;
+};
+
+} // namespace details
+} // namespace spdlog
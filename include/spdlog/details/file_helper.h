@@ -82,8 +82,11 @@ public:
 
     void write(const fmt::memory_buffer &buf)
     {
-        size_t msg_size = buf.size();
-        auto data = buf.data();
+        write(buf.data(), buf.size());
+    }
+
+    void write(const char *data, size_t msg_size)
+    {
         if (std::fwrite(data, 1, msg_size, fd_) != msg_size)
         {
             throw spdlog_ex("Failed writing to file " + os::filename_to_str(_filename), errno);
@@ -0,0 +1,178 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// local time without calling localtime_r for each new second.
+// the std::tm of a time is computed arithmetically from its seconds and the utc offset of its
+// time zone period. the offset is cached per thread along with the next time it changes (the
+// next dst transition), and os::localtime(..) is called again only once that is crossed - or a
+// day later, to notice a transition within a day after that.
+// the time zone is read on refresh only, so changes of TZ or of the system time zone take up to
+// a day to show.
+#pragma once
+
+#include "spdlog/details/os.h"
+
+#include <ctime>
+
+namespace spdlog {
+namespace details {
+
+namespace civil {
+
+// days since 1970-01-01 of the proleptic gregorian date (month is 1-12)
+inline long long days_from_date(long long year, unsigned month, unsigned day) SPDLOG_NOEXCEPT
+{
+    year -= month <= 2;
+    const long long era = (year >= 0 ? year : year - 399) / 400;
+    const auto year_of_era = static_cast<unsigned>(year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<long long>(day_of_era) - 719468;
+}
+
+// seconds since the epoch of the date and time fields of tm, as if they were utc
+inline long long seconds_from_tm(const std::tm &tm) SPDLOG_NOEXCEPT
+{
+    auto days = days_from_date(tm.tm_year + 1900LL, static_cast<unsigned>(tm.tm_mon + 1), static_cast<unsigned>(tm.tm_mday));
+    return days * 86400 + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
+
+// set the date and time fields of tm (all but tm_isdst and the zone extensions) to the utc
+// time of the given seconds since the epoch
+inline void seconds_to_tm(long long secs, std::tm &tm) SPDLOG_NOEXCEPT
+{
+    long long days = secs / 86400;
+    long long secs_of_day = secs % 86400;
+    if (secs_of_day < 0)
+    {
+        secs_of_day += 86400;
+        days--;
+    }
+    tm.tm_hour = static_cast<int>(secs_of_day / 3600);
+    tm.tm_min = static_cast<int>(secs_of_day % 3600 / 60);
+    tm.tm_sec = static_cast<int>(secs_of_day % 60);
+    // 1970-01-01 was a thursday
+    tm.tm_wday = static_cast<int>((days % 7 + 11) % 7);
+
+    const long long shifted = days + 719468; // days since 0000-03-01
+    const long long era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    const auto day_of_era = static_cast<unsigned>(shifted - era * 146097);
+    const unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100); // from march 1st
+    const unsigned mp = (5 * day_of_year + 2) / 153;
+    const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    const long long year = static_cast<long long>(year_of_era) + era * 400 + (month <= 2);
+
+    tm.tm_year = static_cast<int>(year - 1900);
+    tm.tm_mon = static_cast<int>(month - 1);
+    tm.tm_mday = static_cast<int>(day_of_year - (153 * mp + 2) / 5 + 1);
+    tm.tm_yday = static_cast<int>(days - days_from_date(year, 1, 1));
+}
+
+} // namespace civil
+
+class local_time_converter
+{
+public:
+    // the local time of time_tt, the same as os::localtime(time_tt)
+    std::tm localtime(std::time_t time_tt) SPDLOG_NOEXCEPT
+    {
+        refresh_if_needed_(time_tt);
+        // tm_isdst and the zone fields (tm_gmtoff/tm_zone where present) are those of the period
+        std::tm tm = period_tm_;
+        civil::seconds_to_tm(static_cast<long long>(time_tt) + offset_, tm);
+        return tm;
+    }
+
+    // the utc offset of time_tt in minutes
+    int utc_minutes_offset(std::time_t time_tt) SPDLOG_NOEXCEPT
+    {
+        refresh_if_needed_(time_tt);
+        return static_cast<int>(offset_ / 60);
+    }
+
+    // the converter of the calling thread
+    static local_time_converter &instance()
+    {
+        static thread_local local_time_converter converter;
+        return converter;
+    }
+
+private:
+    // how far to look for the next transition
+    static const long long max_period = 24 * 60 * 60;
+
+    // the time zone period [period_begin_, period_end_) has the utc offset_ and the zone fields of period_tm_
+    long long period_begin_ = 0;
+    long long period_end_ = 0;
+    long long offset_ = 0;
+    std::tm period_tm_{};
+
+    void refresh_if_needed_(std::time_t time_tt) SPDLOG_NOEXCEPT
+    {
+        auto secs = static_cast<long long>(time_tt);
+        if (secs < period_begin_ || secs >= period_end_)
+        {
+            refresh_(secs);
+        }
+    }
+
+    static long long offset_of_(const std::tm &tm, long long secs) SPDLOG_NOEXCEPT
+    {
+        return civil::seconds_from_tm(tm) - secs;
+    }
+
+    static bool same_period_(const std::tm &tm, long long secs, long long offset, int isdst) SPDLOG_NOEXCEPT
+    {
+        return offset_of_(tm, secs) == offset && tm.tm_isdst == isdst;
+    }
+
+    // find the period of secs: the offset at secs is valid until the first second that has
+    // another offset, found by bisection if it is within max_period.
+    void refresh_(long long secs) SPDLOG_NOEXCEPT
+    {
+        period_tm_ = os::localtime(static_cast<std::time_t>(secs));
+        offset_ = offset_of_(period_tm_, secs);
+        period_begin_ = secs;
+
+        long long same = secs;
+        long long other = secs + max_period;
+        if (same_period_(os::localtime(static_cast<std::time_t>(other)), other, offset_, period_tm_.tm_isdst))
+        {
+            period_end_ = other;
+            return;
+        }
+        while (other - same > 1)
+        {
+            auto mid = same + (other - same) / 2;
+            if (same_period_(os::localtime(static_cast<std::time_t>(mid)), mid, offset_, period_tm_.tm_isdst))
+            {
+                same = mid;
+            }
+            else
+            {
+                other = mid;
+            }
+        }
+        period_end_ = other;
+    }
+};
+
+namespace local_time {
+
+// the local time of time_tt from the converter of the calling thread
+inline std::tm localtime(std::time_t time_tt) SPDLOG_NOEXCEPT
+{
+    return local_time_converter::instance().localtime(time_tt);
+}
+
+inline int utc_minutes_offset(std::time_t time_tt) SPDLOG_NOEXCEPT
+{
+    return local_time_converter::instance().utc_minutes_offset(time_tt);
+}
+
+} // namespace local_time
+} // namespace details
+} // namespace spdlog
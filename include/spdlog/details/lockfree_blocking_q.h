@@ -0,0 +1,261 @@
+#pragma once
+
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// lock free multi producer-multi consumer blocking queue.
+// same interface as mpmc_blocking_queue, but the items live in a lockfree_ring.
+// the mutex and condition variables are used only to park producers when the
+// queue is full or consumers when it is empty - and producers/consumers
+// notify the other side only if someone is actually parked.
+// enqueue(..) - will block until room found to put the new message.
+// enqueue_nowait(..) - will overrun the oldest message if no room left in the queue.
+// enqueue_for(..) - will block up to a timeout until room found, then give up.
+// try_enqueue(..) - will give up right away if no room left in the queue.
+// enqueue_bulk(..) - same as enqueue(..) for several items, waking up consumers once.
+// dequeue_for(..) - will block until the queue is not empty or timeout have
+// passed.
+// dequeue_bulk_for(..) - same as dequeue_for(..), but pops up to max_items items.
+// a zero timeout makes dequeue_for(..) and dequeue_bulk_for(..) try once and return right away.
+
+#include "spdlog/details/lockfree_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class lockfree_blocking_queue
+{
+public:
+    using item_type = T;
+    explicit lockfree_blocking_queue(size_t max_items, const async_queue_memory &memory = async_queue_memory())
+        : q_(max_items, memory)
+    {
+    }
+
+    // try to enqueue and block if no room left.
+    // on_wait(duration) is called with the time it was blocked (if it was).
+    template<typename OnWait = no_queue_hook>
+    void enqueue(T &&item, OnWait on_wait = OnWait())
+    {
+        if (!try_push_spin_(std::move(item)))
+        {
+            auto wait_start = queue_wait_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                waiting_producers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                pop_cv_.wait(lock, [this, &item] { return this->q_.try_push(std::move(item)); });
+                waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            notify_consumer_();
+            on_wait(queue_wait_clock::now() - wait_start);
+            return;
+        }
+        notify_consumer_();
+    }
+
+    // try to enqueue and block up to timeout if no room left.
+    // return false (and leave the item untouched) if it timed out.
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        if (!try_push_spin_(std::move(item)))
+        {
+            auto wait_start = queue_wait_clock::now();
+            bool pushed;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                waiting_producers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                pushed = pop_cv_.wait_for(lock, timeout, [this, &item] { return this->q_.try_push(std::move(item)); });
+                waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            on_wait(queue_wait_clock::now() - wait_start);
+            if (!pushed)
+            {
+                return false;
+            }
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // enqueue if there is room. return false (and leave the item untouched) if not.
+    // takes no lock.
+    bool try_enqueue(T &&item)
+    {
+        if (!q_.try_push(std::move(item)))
+        {
+            return false;
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // enqueue the items in order, notifying consumers once (unless it has to wait for room).
+    template<typename OnWait = no_queue_hook>
+    void enqueue_bulk(T *items, size_t n, OnWait on_wait = OnWait())
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!q_.try_push(std::move(items[i])))
+            {
+                notify_consumer_();
+                enqueue(std::move(items[i]), on_wait);
+            }
+        }
+        notify_consumer_();
+    }
+
+    // enqueue immediately. overrun oldest message in the queue if no room left.
+    // on_overrun(item) is called with each overrun item.
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun = OnOverrun())
+    {
+        while (!q_.try_push(std::move(item)))
+        {
+            T discarded;
+            if (q_.try_pop(discarded))
+            {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+                on_overrun(static_cast<const T &>(discarded));
+            }
+        }
+        notify_consumer_();
+    }
+
+    // try to dequeue item. if no item found. wait upto timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (wait_duration <= std::chrono::milliseconds::zero())
+        {
+            if (!q_.try_pop(popped_item))
+            {
+                return false;
+            }
+        }
+        else if (!try_pop_spin_(popped_item))
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            waiting_consumers_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool dequeued = push_cv_.wait_for(lock, wait_duration, [this, &popped_item] { return this->q_.try_pop(popped_item); });
+            waiting_consumers_.fetch_sub(1, std::memory_order_relaxed);
+            if (!dequeued)
+            {
+                return false;
+            }
+        }
+        notify_popped_(1);
+        return true;
+    }
+
+    // try to dequeue up to max_items items. if no item found. wait upto timeout and try again
+    // Return the number of dequeued items (0 if timed out)
+    size_t dequeue_bulk_for(T *popped_items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        if (max_items == 0 || !dequeue_for(popped_items[0], wait_duration))
+        {
+            return 0;
+        }
+        size_t popped = 1;
+        while (popped < max_items && q_.try_pop(popped_items[popped]))
+        {
+            popped++;
+        }
+        if (popped > 1)
+        {
+            notify_popped_(popped - 1);
+        }
+        return popped;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // number of push/pop attempts (yielding in between) before parking
+    static const int spin_tries = 16;
+
+    bool try_push_spin_(T &&item)
+    {
+        for (int i = 0; i < spin_tries; i++)
+        {
+            if (q_.try_push(std::move(item)))
+            {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    bool try_pop_spin_(T &popped_item)
+    {
+        for (int i = 0; i < spin_tries; i++)
+        {
+            if (q_.try_pop(popped_item))
+            {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    // the fences pair with the ones taken before parking: either the parked side sees
+    // the new state of the ring, or we see it waiting and wake it up.
+    void notify_consumer_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_consumers_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+            }
+            push_cv_.notify_one();
+        }
+    }
+
+    // room was made for popped items - wake up as many parked producers
+    void notify_popped_(size_t popped)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_producers_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+            }
+            if (popped > 1)
+            {
+                pop_cv_.notify_all();
+            }
+            else
+            {
+                pop_cv_.notify_one();
+            }
+        }
+    }
+
+    lockfree_ring<T> q_;
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    std::atomic<size_t> waiting_consumers_{0};
+    std::atomic<size_t> waiting_producers_{0};
+    std::atomic<size_t> overrun_counter_{0};
+};
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,157 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// bounded lock free ring (multi producer-multi consumer).
+// each slot carries a sequence number that tells producers and consumers whether
+// it is free to write or ready to read, so no lock is ever taken.
+// the enqueue and dequeue positions live on separate cache lines to avoid false
+// sharing between producers and consumers.
+// capacity is rounded up to the next power of two.
+#pragma once
+
+#include "spdlog/details/queue_storage.h"
+
+#include <atomic>
+#include <cstddef>
+
+namespace spdlog {
+namespace details {
+
+static const size_t cache_line_size = 64;
+
+// atomic counter preceded by a full cache line of padding, so it never shares
+// a cache line with the fields declared before it.
+struct padded_atomic_size
+{
+    char pad[cache_line_size];
+    std::atomic<size_t> value{0};
+};
+
+template<typename T>
+class lockfree_ring
+{
+public:
+    using item_type = T;
+
+    explicit lockfree_ring(size_t max_items, const async_queue_memory &memory = async_queue_memory())
+        : capacity_(round_up_pow2_(max_items))
+        , mask_(capacity_ - 1)
+        , cells_(capacity_, memory)
+    {
+        for (size_t i = 0; i < capacity_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    lockfree_ring(const lockfree_ring &) = delete;
+    lockfree_ring &operator=(const lockfree_ring &) = delete;
+
+    // try to push the item. return false (and leave the item untouched) if no room left
+    bool try_push(T &&item)
+    {
+        cell *c;
+        size_t pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = std::move(item);
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // try to pop the oldest item. return false if the ring is empty
+    bool try_pop(T &popped_item)
+    {
+        cell *c;
+        size_t pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+        popped_item = std::move(c->data);
+        c->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    // approximate number of items (exact when there are no concurrent calls)
+    size_t size() const
+    {
+        size_t tail = enqueue_pos_.value.load(std::memory_order_acquire);
+        size_t head = dequeue_pos_.value.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static size_t round_up_pow2_(size_t n)
+    {
+        size_t rv = 1;
+        while (rv < n)
+        {
+            rv <<= 1;
+        }
+        return rv;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    queue_storage<cell> cells_;
+
+    padded_atomic_size enqueue_pos_;
+    padded_atomic_size dequeue_pos_;
+};
+} // namespace details
+} // namespace spdlog
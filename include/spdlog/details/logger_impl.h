@@ -69,6 +69,14 @@ inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const
     {
         using details::fmt_helper::to_string_view;
         fmt::memory_buffer buf;
+        if (details::deferred_args<Args...>::supported && defer_formatting_.load(std::memory_order_relaxed))
+        {
+            // capture the arguments and let sink_it_deferred_(..) decide when to format them
+            details::deferred_args<Args...>::write(buf, fmt, args...);
+            details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
+            sink_it_deferred_(log_msg, &details::deferred_args<Args...>::format);
+            return;
+        }
         fmt::format_to(buf, fmt, args...);
         details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
         sink_it_(log_msg);
@@ -340,6 +348,18 @@ inline void spdlog::logger::flush()
     SPDLOG_CATCH_AND_HANDLE
 }
 
+inline std::future<void> spdlog::logger::flush_with_future()
+{
+    std::unique_ptr<std::promise<void>> flushed(new std::promise<void>());
+    auto future = flushed->get_future();
+    try
+    {
+        flush_with_future_(std::move(flushed));
+    }
+    SPDLOG_CATCH_AND_HANDLE
+    return future;
+}
+
 inline void spdlog::logger::flush_on(level::level_enum log_level)
 {
     flush_level_.store(log_level);
@@ -380,11 +400,13 @@ inline void spdlog::logger::sink_it_(details::log_msg &msg)
 #if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
     incr_msg_counter_(msg);
 #endif
+    // sinks with equivalent formatters share the formatted text
+    details::shared_format shared(msg);
     for (auto &sink : sinks_)
     {
         if (sink->should_log(msg.level))
         {
-            sink->log(msg);
+            sink->log_shared(msg, shared);
         }
     }
 
@@ -394,6 +416,17 @@ inline void spdlog::logger::sink_it_(details::log_msg &msg)
     }
 }
 
+inline void spdlog::logger::sink_it_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+    using details::fmt_helper::to_string_view;
+    fmt::memory_buffer buf;
+    format_fn(msg.payload.data(), buf);
+    details::log_msg formatted_msg(msg.source, msg.logger_name, msg.level, to_string_view(buf));
+    formatted_msg.time = msg.time;
+    formatted_msg.thread_id = msg.thread_id;
+    sink_it_(formatted_msg);
+}
+
 inline void spdlog::logger::flush_()
 {
     for (auto &sink : sinks_)
@@ -402,6 +435,12 @@ inline void spdlog::logger::flush_()
     }
 }
 
+inline void spdlog::logger::flush_with_future_(std::unique_ptr<std::promise<void>> flushed)
+{
+    flush_();
+    flushed->set_value();
+}
+
 inline void spdlog::logger::default_err_handler_(const std::string &msg)
 {
     auto now = time(nullptr);
@@ -9,11 +9,19 @@
 // enqueue(..) - will block until room found to put the new message.
 // enqueue_nowait(..) - will return immediately with false if no room left in
 // the queue.
+// enqueue_for(..) - will block up to a timeout until room found, then give up.
+// try_enqueue(..) - will give up right away if no room left in the queue.
+// enqueue_bulk(..) - same as enqueue(..) for several items, under a single lock.
 // dequeue_for(..) - will block until the queue is not empty or timeout have
 // passed.
+// dequeue_bulk_for(..) - same as dequeue_for(..), but pops up to max_items
+// items under a single lock.
+// a zero timeout makes dequeue_for(..) and dequeue_bulk_for(..) return right away.
 
 #include "spdlog/details/circular_q.h"
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -25,68 +33,253 @@ class mpmc_blocking_queue
 {
 public:
     using item_type = T;
-    explicit mpmc_blocking_queue(size_t max_items)
-        : q_(max_items)
+    explicit mpmc_blocking_queue(size_t max_items, const async_queue_memory &memory = async_queue_memory())
+        : q_(max_items, memory)
     {
     }
 
 #ifndef __MINGW32__
-    // try to enqueue and block if no room left
-    void enqueue(T &&item)
+    // try to enqueue and block if no room left.
+    // on_wait(duration) is called with the time it was blocked (if it was).
+    template<typename OnWait = no_queue_hook>
+    void enqueue(T &&item, OnWait on_wait = OnWait())
+    {
+        bool notify;
+        queue_wait_clock::duration waited;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            waited = wait_for_room_(lock);
+            push_back_(std::move(item));
+            notify = waiting_consumers_ > 0;
+        }
+        notify_pushed_(notify);
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+    }
+
+    // try to enqueue and block up to timeout if no room left.
+    // return false (and leave the item untouched) if it timed out.
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        bool notify;
+        bool has_room;
+        auto waited = queue_wait_clock::duration::zero();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            has_room = wait_for_room_for_(lock, timeout, waited);
+            if (has_room)
+            {
+                push_back_(std::move(item));
+            }
+            notify = has_room && waiting_consumers_ > 0;
+        }
+        notify_pushed_(notify);
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+        return has_room;
+    }
+
+    // enqueue if there is room. return false (and leave the item untouched) if not -
+    // without taking the lock if the queue is known to be full.
+    bool try_enqueue(T &&item)
+    {
+        if (full_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (q_.full())
+            {
+                return false;
+            }
+            push_back_(std::move(item));
+            notify = waiting_consumers_ > 0;
+        }
+        notify_pushed_(notify);
+        return true;
+    }
+
+    // enqueue the items in order under a single lock (unless it has to wait for room).
+    template<typename OnWait = no_queue_hook>
+    void enqueue_bulk(T *items, size_t n, OnWait on_wait = OnWait())
     {
+        bool notify;
+        auto waited = queue_wait_clock::duration::zero();
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
-            q_.push_back(std::move(item));
+            for (size_t i = 0; i < n; i++)
+            {
+                if (q_.full() && waiting_consumers_ > 0)
+                {
+                    // let consumers take the items pushed so far before waiting for them
+                    push_cv_.notify_all();
+                }
+                waited += wait_for_room_(lock);
+                push_back_(std::move(items[i]));
+            }
+            notify = waiting_consumers_ > 0;
+        }
+        if (notify)
+        {
+            push_cv_.notify_all();
+        }
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
         }
-        push_cv_.notify_one();
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
-    void enqueue_nowait(T &&item)
+    // on_overrun(item) is called (under the queue's lock) with each overrun item.
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun = OnOverrun())
     {
+        bool notify;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            q_.push_back(std::move(item));
+            push_back_(std::move(item), on_overrun);
+            notify = waiting_consumers_ > 0;
         }
-        push_cv_.notify_one();
+        notify_pushed_(notify);
     }
 
     // try to dequeue item. if no item found. wait upto timeout and try again
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
+        bool notify;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+            if (!wait_for_item_(lock, wait_duration))
             {
                 return false;
             }
             q_.pop_front(popped_item);
+            full_.store(false, std::memory_order_relaxed);
+            notify = waiting_producers_ > 0;
         }
-        pop_cv_.notify_one();
+        notify_popped_(notify, 1);
         return true;
     }
 
+    // try to dequeue up to max_items items. if no item found. wait upto timeout and try again
+    // Return the number of dequeued items (0 if timed out)
+    size_t dequeue_bulk_for(T *popped_items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        size_t popped = 0;
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!wait_for_item_(lock, wait_duration))
+            {
+                return 0;
+            }
+            while (popped < max_items && !q_.empty())
+            {
+                q_.pop_front(popped_items[popped++]);
+            }
+            full_.store(false, std::memory_order_relaxed);
+            notify = waiting_producers_ > 0;
+        }
+        notify_popped_(notify, popped);
+        return popped;
+    }
+
 #else
     // apparently mingw deadlocks if the mutex is released before cv.notify_one(),
     // so release the mutex at the very end each function.
 
     // try to enqueue and block if no room left
-    void enqueue(T &&item)
+    template<typename OnWait = no_queue_hook>
+    void enqueue(T &&item, OnWait on_wait = OnWait())
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        pop_cv_.wait(lock, [this] { return !this->q_.full(); });
-        q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        auto waited = wait_for_room_(lock);
+        push_back_(std::move(item));
+        notify_pushed_(waiting_consumers_ > 0);
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+    }
+
+    // try to enqueue and block up to timeout if no room left.
+    // return false (and leave the item untouched) if it timed out.
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto waited = queue_wait_clock::duration::zero();
+        bool has_room = wait_for_room_for_(lock, timeout, waited);
+        if (has_room)
+        {
+            push_back_(std::move(item));
+            notify_pushed_(waiting_consumers_ > 0);
+        }
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
+        return has_room;
+    }
+
+    // enqueue if there is room. return false (and leave the item untouched) if not -
+    // without taking the lock if the queue is known to be full.
+    bool try_enqueue(T &&item)
+    {
+        if (full_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (q_.full())
+        {
+            return false;
+        }
+        push_back_(std::move(item));
+        notify_pushed_(waiting_consumers_ > 0);
+        return true;
+    }
+
+    // enqueue the items in order under a single lock (unless it has to wait for room).
+    template<typename OnWait = no_queue_hook>
+    void enqueue_bulk(T *items, size_t n, OnWait on_wait = OnWait())
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        auto waited = queue_wait_clock::duration::zero();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (q_.full() && waiting_consumers_ > 0)
+            {
+                push_cv_.notify_all();
+            }
+            waited += wait_for_room_(lock);
+            push_back_(std::move(items[i]));
+        }
+        if (waiting_consumers_ > 0)
+        {
+            push_cv_.notify_all();
+        }
+        if (waited != queue_wait_clock::duration::zero())
+        {
+            on_wait(waited);
+        }
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
-    void enqueue_nowait(T &&item)
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun = OnOverrun())
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        push_back_(std::move(item), on_overrun);
+        notify_pushed_(waiting_consumers_ > 0);
     }
 
     // try to dequeue item. if no item found. wait upto timeout and try again
@@ -94,15 +287,35 @@ public:
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+        if (!wait_for_item_(lock, wait_duration))
         {
             return false;
         }
         q_.pop_front(popped_item);
-        pop_cv_.notify_one();
+        full_.store(false, std::memory_order_relaxed);
+        notify_popped_(waiting_producers_ > 0, 1);
         return true;
     }
 
+    // try to dequeue up to max_items items. if no item found. wait upto timeout and try again
+    // Return the number of dequeued items (0 if timed out)
+    size_t dequeue_bulk_for(T *popped_items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_for_item_(lock, wait_duration))
+        {
+            return 0;
+        }
+        size_t popped = 0;
+        while (popped < max_items && !q_.empty())
+        {
+            q_.pop_front(popped_items[popped++]);
+        }
+        full_.store(false, std::memory_order_relaxed);
+        notify_popped_(waiting_producers_ > 0, popped);
+        return popped;
+    }
+
 #endif
 
     size_t overrun_counter()
@@ -112,9 +325,97 @@ public:
     }
 
 private:
+    // the waiting counters below let producers and consumers skip notifying the other
+    // side when nobody waits (the common case when both keep up).
+
+    // wait until there is room in the queue. must be called under queue_mutex_.
+    // return how long it waited (zero if there was room)
+    queue_wait_clock::duration wait_for_room_(std::unique_lock<std::mutex> &lock)
+    {
+        if (!q_.full())
+        {
+            return queue_wait_clock::duration::zero();
+        }
+        auto wait_start = queue_wait_clock::now();
+        waiting_producers_++;
+        pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+        waiting_producers_--;
+        return queue_wait_clock::now() - wait_start;
+    }
+
+    // same, but wait up to timeout. return false if there is still no room
+    bool wait_for_room_for_(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds timeout, queue_wait_clock::duration &waited)
+    {
+        if (!q_.full())
+        {
+            return true;
+        }
+        auto wait_start = queue_wait_clock::now();
+        waiting_producers_++;
+        bool has_room = pop_cv_.wait_for(lock, timeout, [this] { return !this->q_.full(); });
+        waiting_producers_--;
+        waited = queue_wait_clock::now() - wait_start;
+        return has_room;
+    }
+
+    // push under queue_mutex_, and keep full_ up to date for try_enqueue(..)
+    template<typename OnOverrun = no_queue_hook>
+    void push_back_(T &&item, OnOverrun on_overrun = OnOverrun())
+    {
+        q_.push_back(std::move(item), on_overrun);
+        full_.store(q_.full(), std::memory_order_relaxed);
+    }
+
+    // wait upto timeout until the queue is not empty (never blocks if the timeout is zero).
+    // must be called under queue_mutex_
+    bool wait_for_item_(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds wait_duration)
+    {
+        if (!q_.empty())
+        {
+            return true;
+        }
+        if (wait_duration <= std::chrono::milliseconds::zero())
+        {
+            return false;
+        }
+        waiting_consumers_++;
+        bool has_item = push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); });
+        waiting_consumers_--;
+        return has_item;
+    }
+
+    void notify_pushed_(bool consumers_waiting)
+    {
+        if (consumers_waiting)
+        {
+            push_cv_.notify_one();
+        }
+    }
+
+    // room was made for popped items - wake up as many blocked producers
+    void notify_popped_(bool producers_waiting, size_t popped)
+    {
+        if (!producers_waiting)
+        {
+            return;
+        }
+        if (popped > 1)
+        {
+            pop_cv_.notify_all();
+        }
+        else
+        {
+            pop_cv_.notify_one();
+        }
+    }
+
     std::mutex queue_mutex_;
     std::condition_variable push_cv_;
     std::condition_variable pop_cv_;
+    size_t waiting_consumers_ = 0;
+    size_t waiting_producers_ = 0;
+    // set under queue_mutex_, read without it by try_enqueue(..)
+    std::atomic<bool> full_{false};
     spdlog::details::circular_q<T> q_;
 };
 } // namespace details
@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -17,6 +18,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <thread>
+#include <vector>
 
 #ifdef _WIN32
 
@@ -38,6 +40,9 @@
 #else // unix
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #ifdef __linux__
@@ -357,6 +362,196 @@ inline void sleep_for_millis(int milliseconds) SPDLOG_NOEXCEPT
 #endif
 }
 
+// hint the cpu that we are in a spin-wait loop (lets the sibling hyper thread run and
+// saves power). no-op where there is no such instruction.
+inline void cpu_relax() SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    YieldProcessor();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// run the calling thread on the given cpus only. throw spdlog_ex on failure
+inline void set_thread_affinity(const std::vector<size_t> &cpus)
+{
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus)
+    {
+        if (cpu >= sizeof(mask) * 8)
+        {
+            throw spdlog_ex("set_thread_affinity: cpu " + std::to_string(cpu) + " out of range");
+        }
+        mask |= DWORD_PTR(1) << cpu;
+    }
+    if (::SetThreadAffinityMask(::GetCurrentThread(), mask) == 0)
+    {
+        throw spdlog_ex("set_thread_affinity failed", static_cast<int>(::GetLastError()));
+    }
+#elif defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            throw spdlog_ex("set_thread_affinity: cpu " + std::to_string(cpu) + " out of range");
+        }
+        CPU_SET(cpu, &cpu_set);
+    }
+    int rv = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (rv != 0)
+    {
+        throw spdlog_ex("set_thread_affinity failed", rv);
+    }
+#else
+    (void)cpus;
+    throw spdlog_ex("set_thread_affinity: not supported on this platform");
+#endif
+}
+
+// name the calling thread (shows in debuggers, top..). no-op where not supported
+inline void set_thread_name(const std::string &name) SPDLOG_NOEXCEPT
+{
+#if defined(__linux__)
+    // at most 15 chars (else it fails)
+    ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+#elif defined(__APPLE__)
+    ::pthread_setname_np(name.c_str());
+#else
+    (void)name;
+#endif
+}
+
+// set the scheduling policy and priority of the calling thread. throw spdlog_ex on failure
+inline void set_thread_scheduling(int policy, int priority)
+{
+#if defined(_WIN32)
+    (void)policy;
+    (void)priority;
+    throw spdlog_ex("set_thread_scheduling: not supported on this platform");
+#else
+    sched_param param{};
+    param.sched_priority = priority;
+    int rv = ::pthread_setschedparam(::pthread_self(), policy, &param);
+    if (rv != 0)
+    {
+        throw spdlog_ex("set_thread_scheduling failed", rv);
+    }
+#endif
+}
+
+// size of a memory page
+inline size_t page_size() SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#else
+    return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// size of the transparent huge pages of x86-64 and most arm64 kernels
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+// allocate page aligned (zeroed) memory straight from the os. throw spdlog_ex on failure.
+// huge_pages: ask for transparent huge pages (linux only, best effort) - the region is then
+// aligned and rounded up to huge_page_size so the kernel can actually use them.
+// bytes is updated to the size of the region (to be passed to free_pages(..)).
+inline void *alloc_pages(size_t &bytes, bool huge_pages)
+{
+#if defined(_WIN32)
+    (void)huge_pages;
+    void *p = ::VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p == nullptr)
+    {
+        throw spdlog_ex("alloc_pages failed", static_cast<int>(::GetLastError()));
+    }
+    return p;
+#else
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (huge_pages)
+    {
+        size_t huge_bytes = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+        // over-allocate and trim, so the region starts on a huge page boundary
+        size_t mapped_bytes = huge_bytes + huge_page_size;
+        void *mapped = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+        {
+            throw spdlog_ex("alloc_pages failed", errno);
+        }
+        auto start = reinterpret_cast<uintptr_t>(mapped);
+        auto aligned = (start + huge_page_size - 1) / huge_page_size * huge_page_size;
+        size_t head = aligned - start;
+        size_t tail = mapped_bytes - head - huge_bytes;
+        if (head > 0)
+        {
+            ::munmap(mapped, head);
+        }
+        if (tail > 0)
+        {
+            ::munmap(reinterpret_cast<void *>(aligned + huge_bytes), tail);
+        }
+        ::madvise(reinterpret_cast<void *>(aligned), huge_bytes, MADV_HUGEPAGE); // just a hint
+        bytes = huge_bytes;
+        return reinterpret_cast<void *>(aligned);
+    }
+#else
+    (void)huge_pages;
+#endif
+    void *p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        throw spdlog_ex("alloc_pages failed", errno);
+    }
+    return p;
+#endif
+}
+
+inline void free_pages(void *p, size_t bytes) SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    (void)bytes;
+    ::VirtualFree(p, 0, MEM_RELEASE);
+#else
+    ::munmap(p, bytes);
+#endif
+}
+
+// write to every page of the region, so accessing it later never page faults
+inline void prefault_pages(void *p, size_t bytes) SPDLOG_NOEXCEPT
+{
+    auto *bytes_p = static_cast<volatile char *>(p);
+    size_t page = page_size();
+    for (size_t offset = 0; offset < bytes; offset += page)
+    {
+        bytes_p[offset] = 0;
+    }
+}
+
+// lock the region in ram (it is never swapped out). throw spdlog_ex on failure
+// (e.g. if it exceeds RLIMIT_MEMLOCK).
+inline void lock_pages(void *p, size_t bytes)
+{
+#if defined(_WIN32)
+    if (!::VirtualLock(p, bytes))
+    {
+        throw spdlog_ex("lock_pages failed", static_cast<int>(::GetLastError()));
+    }
+#else
+    if (::mlock(p, bytes) != 0)
+    {
+        throw spdlog_ex("lock_pages failed", errno);
+    }
+#endif
+}
+
 // wchar support for windows file names (SPDLOG_WCHAR_FILENAMES must be defined)
 #if defined(_WIN32) && defined(SPDLOG_WCHAR_FILENAMES)
 #define SPDLOG_FILENAME_T(s) L##s
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "spdlog/details/fmt_helper.h"
+#include "spdlog/details/local_time.h"
 #include "spdlog/details/log_msg.h"
 #include "spdlog/details/os.h"
 #include "spdlog/fmt/fmt.h"
@@ -626,8 +627,6 @@ public:
     explicit z_formatter(padding_info padinfo)
         : flag_formatter(padinfo){};
 
-    const std::chrono::seconds cache_refresh = std::chrono::seconds(5);
-
     z_formatter() = default;
     z_formatter(const z_formatter &) = delete;
     z_formatter &operator=(const z_formatter &) = delete;
@@ -638,7 +637,9 @@ public:
         scoped_pad p(field_size, padinfo_, dest);
 
 #ifdef _WIN32
-        int total_minutes = get_cached_offset(msg, tm_time);
+        // the offset of the time zone period of the message, without asking windows each time
+        int total_minutes = local_time::utc_minutes_offset(log_clock::to_time_t(msg.time));
+        (void)(tm_time);
 #else
         // No need to chache under gcc,
         // it is very fast (already stored in tm.tm_gmtoff)
@@ -660,22 +661,6 @@ public:
         dest.push_back(':');
         fmt_helper::pad2(total_minutes % 60, dest); // minutes
     }
-
-private:
-    log_clock::time_point last_update_{std::chrono::seconds(0)};
-#ifdef _WIN32
-    int offset_minutes_{0};
-
-    int get_cached_offset(const log_msg &msg, const std::tm &tm_time)
-    {
-        if (msg.time - last_update_ >= cache_refresh)
-        {
-            offset_minutes_ = os::utc_minutes_offset(tm_time);
-            last_update_ = msg.time;
-        }
-        return offset_minutes_;
-    }
-#endif
 };
 
 // Thread id
@@ -993,6 +978,40 @@ private:
     fmt::basic_memory_buffer<char, 128> cached_datetime_;
 };
 
+// a flag of a compiled pattern, or a literal run of it (see pattern_formatter::compile_pattern_(..))
+struct pattern_op
+{
+    // 0 for the literal run [literal_begin, literal_begin + literal_size) of the literal pool.
+    // datetime_run_flag for a run of the literal_size date/time and literal ops that follow,
+    // rendered once per second into the text of datetime run literal_begin.
+    char flag;
+    unsigned char pad_side;
+    unsigned char pad_width; // at most 128
+    uint32_t literal_begin;
+    uint32_t literal_size;
+
+    padding_info padding() const
+    {
+        return padding_info(pad_width, static_cast<padding_info::pad_side>(pad_side));
+    }
+};
+
+const char datetime_run_flag = '\1';
+
+// the text of a datetime run op, in the per second cache of the pattern formatter
+struct datetime_run
+{
+    size_t text_begin;
+    size_t text_size;
+};
+
+// the format_key() of a pattern formatter. the eol is prefixed by its size, so the key can't be
+// mistaken for one of another pattern.
+inline std::string pattern_format_key(const std::string &pattern, pattern_time_type time_type, const std::string &eol)
+{
+    return fmt::format("{}:{}:{}{}", static_cast<int>(time_type), eol.size(), eol, pattern);
+}
+
 } // namespace details
 
 class pattern_formatter final : public formatter
@@ -1003,21 +1022,19 @@ public:
         : pattern_(std::move(pattern))
         , eol_(std::move(eol))
         , pattern_time_type_(time_type)
-        , last_log_secs_(0)
+        , last_log_secs_(std::chrono::seconds::min())
     {
         std::memset(&cached_tm_, 0, sizeof(cached_tm_));
         compile_pattern_(pattern_);
+#ifndef SPDLOG_NO_DATETIME
+        group_datetime_runs_();
+#endif
     }
 
     // use by default full formatter for if pattern is not given
     explicit pattern_formatter(pattern_time_type time_type = pattern_time_type::local, std::string eol = spdlog::details::os::default_eol)
-        : pattern_("%+")
-        , eol_(std::move(eol))
-        , pattern_time_type_(time_type)
-        , last_log_secs_(0)
+        : pattern_formatter("%+", time_type, std::move(eol))
     {
-        std::memset(&cached_tm_, 0, sizeof(cached_tm_));
-        formatters_.push_back(details::make_unique<details::full_formatter>(details::padding_info{}));
     }
 
     pattern_formatter(const pattern_formatter &other) = delete;
@@ -1028,6 +1045,11 @@ public:
         return details::make_unique<pattern_formatter>(pattern_, pattern_time_type_, eol_);
     }
 
+    string_view_t format_key() const override
+    {
+        return key_;
+    }
+
     void format(const details::log_msg &msg, fmt::memory_buffer &dest) override
     {
 #ifndef SPDLOG_NO_DATETIME
@@ -1036,12 +1058,10 @@ public:
         {
             cached_tm_ = get_time_(msg);
             last_log_secs_ = secs;
+            render_datetime_runs_(msg);
         }
 #endif
-        for (auto &f : formatters_)
-        {
-            f->format(msg, cached_tm_, dest);
-        }
+        format_ops_(ops_.data(), ops_.data() + ops_.size(), msg, dest);
         // write eol
         details::fmt_helper::append_string_view(eol_, dest);
     }
@@ -1050,184 +1070,439 @@ private:
     std::string pattern_;
     std::string eol_;
     pattern_time_type pattern_time_type_;
+    std::string key_ = details::pattern_format_key(pattern_, pattern_time_type_, eol_);
     std::tm cached_tm_;
     std::chrono::seconds last_log_secs_;
 
-    std::vector<std::unique_ptr<details::flag_formatter>> formatters_;
+    // the compiled pattern: a flat array of ops, interpreted by format_ops_(..), and the
+    // chars of its literal runs.
+    std::vector<details::pattern_op> ops_;
+    std::string literals_;
+    // the flag formatter that keeps state across messages
+    details::full_formatter full_formatter_{details::padding_info{}};
+    // the text of the datetime runs for the second of last_log_secs_
+    std::vector<details::datetime_run> datetime_runs_;
+    fmt::memory_buffer cached_datetime_;
 
     std::tm get_time_(const details::log_msg &msg)
     {
         if (pattern_time_type_ == pattern_time_type::local)
         {
-            return details::os::localtime(log_clock::to_time_t(msg.time));
+            return details::local_time::localtime(log_clock::to_time_t(msg.time));
         }
         return details::os::gmtime(log_clock::to_time_t(msg.time));
     }
 
-    void handle_flag_(char flag, details::padding_info padding)
+    // the stateless flag formatters live on the stack, and are called without virtual dispatch
+    template<typename Formatter>
+    void format_flag_(const details::pattern_op &op, const details::log_msg &msg, fmt::memory_buffer &dest)
     {
-        switch (flag)
+        Formatter formatter(op.padding());
+        formatter.Formatter::format(msg, cached_tm_, dest);
+    }
+
+    // the interpreter loop. the common flags, when not padded, are formatted right here -
+    // the same way their flag formatters do. the rest go through format_op_(..).
+    void format_ops_(const details::pattern_op *first, const details::pattern_op *last, const details::log_msg &msg, fmt::memory_buffer &dest)
+    {
+        using namespace details;
+        for (auto it = first; it != last; ++it)
         {
+            auto &op = *it;
+            if (op.pad_width != 0)
+            {
+                format_op_(op, msg, dest);
+                continue;
+            }
+            switch (op.flag)
+            {
+            case '\0': // literal run - mostly a single separator char
+                if (op.literal_size == 1)
+                {
+                    dest.push_back(literals_[op.literal_begin]);
+                }
+                else
+                {
+                    fmt_helper::append_string_view(string_view_t(literals_.data() + op.literal_begin, op.literal_size), dest);
+                }
+                break;
+            case datetime_run_flag: {
+                // the cached text of the run - its ops are skipped
+                auto &run = datetime_runs_[op.literal_begin];
+                fmt_helper::append_string_view(string_view_t(cached_datetime_.data() + run.text_begin, run.text_size), dest);
+                it += op.literal_size;
+                break;
+            }
+            case 'v':
+                fmt_helper::append_string_view(msg.payload, dest);
+                break;
+            case 'n':
+                fmt_helper::append_string_view(*msg.logger_name, dest);
+                break;
+            case 'l':
+                fmt_helper::append_string_view(level::to_string_view(msg.level), dest);
+                break;
+            case 't':
+                fmt_helper::append_int(msg.thread_id, dest);
+                break;
+            case 'Y':
+                fmt_helper::append_int(cached_tm_.tm_year + 1900, dest);
+                break;
+            case 'm':
+                fmt_helper::pad2(cached_tm_.tm_mon + 1, dest);
+                break;
+            case 'd':
+                fmt_helper::pad2(cached_tm_.tm_mday, dest);
+                break;
+            case 'H':
+                fmt_helper::pad2(cached_tm_.tm_hour, dest);
+                break;
+            case 'M':
+                fmt_helper::pad2(cached_tm_.tm_min, dest);
+                break;
+            case 'S':
+                fmt_helper::pad2(cached_tm_.tm_sec, dest);
+                break;
+            case 'C':
+                fmt_helper::pad2(cached_tm_.tm_year % 100, dest);
+                break;
+            case 'I':
+                fmt_helper::pad2(to12h(cached_tm_), dest);
+                break;
+            case 'p':
+                fmt_helper::append_string_view(ampm(cached_tm_), dest);
+                break;
+            case 'D':
+                fmt_helper::pad2(cached_tm_.tm_mon + 1, dest);
+                dest.push_back('/');
+                fmt_helper::pad2(cached_tm_.tm_mday, dest);
+                dest.push_back('/');
+                fmt_helper::pad2(cached_tm_.tm_year % 100, dest);
+                break;
+            case 'R':
+                fmt_helper::pad2(cached_tm_.tm_hour, dest);
+                dest.push_back(':');
+                fmt_helper::pad2(cached_tm_.tm_min, dest);
+                break;
+            case 'T':
+                fmt_helper::pad2(cached_tm_.tm_hour, dest);
+                dest.push_back(':');
+                fmt_helper::pad2(cached_tm_.tm_min, dest);
+                dest.push_back(':');
+                fmt_helper::pad2(cached_tm_.tm_sec, dest);
+                break;
+            case 'e':
+                fmt_helper::pad3(static_cast<uint32_t>(fmt_helper::time_fraction<std::chrono::milliseconds>(msg.time).count()), dest);
+                break;
+            case 'f':
+                fmt_helper::pad6(static_cast<size_t>(fmt_helper::time_fraction<std::chrono::microseconds>(msg.time).count()), dest);
+                break;
+            case 'F':
+                fmt_helper::pad9(static_cast<size_t>(fmt_helper::time_fraction<std::chrono::nanoseconds>(msg.time).count()), dest);
+                break;
+            default:
+                format_op_(op, msg, dest);
+            }
+        }
+    }
 
-        case ('+'): // default formatter
-            formatters_.push_back(details::make_unique<details::full_formatter>(padding));
+    // format any op, padded or not
+    void format_op_(const details::pattern_op &op, const details::log_msg &msg, fmt::memory_buffer &dest)
+    {
+        using namespace details;
+        switch (op.flag)
+        {
+        case '\0': // literal run
+            fmt_helper::append_string_view(string_view_t(literals_.data() + op.literal_begin, op.literal_size), dest);
             break;
-
-        case 'n': // logger name
-            formatters_.push_back(details::make_unique<details::name_formatter>(padding));
+        case '+':
+            full_formatter_.full_formatter::format(msg, cached_tm_, dest);
             break;
-
-        case 'l': // level
-            formatters_.push_back(details::make_unique<details::level_formatter>(padding));
+        case 'n':
+            format_flag_<name_formatter>(op, msg, dest);
             break;
-
-        case 'L': // short level
-            formatters_.push_back(details::make_unique<details::short_level_formatter>(padding));
+        case 'l':
+            format_flag_<level_formatter>(op, msg, dest);
             break;
-
-        case ('t'): // thread id
-            formatters_.push_back(details::make_unique<details::t_formatter>(padding));
+        case 'L':
+            format_flag_<short_level_formatter>(op, msg, dest);
             break;
-
-        case ('v'): // the message text
-            formatters_.push_back(details::make_unique<details::v_formatter>(padding));
+        case 't':
+            format_flag_<t_formatter>(op, msg, dest);
             break;
-
-        case ('a'): // weekday
-            formatters_.push_back(details::make_unique<details::a_formatter>(padding));
+        case 'v':
+            format_flag_<v_formatter>(op, msg, dest);
             break;
-
-        case ('A'): // short weekday
-            formatters_.push_back(details::make_unique<details::A_formatter>(padding));
+        case 'a':
+            format_flag_<a_formatter>(op, msg, dest);
             break;
-
-        case ('b'):
-        case ('h'): // month
-            formatters_.push_back(details::make_unique<details::b_formatter>(padding));
+        case 'A':
+            format_flag_<A_formatter>(op, msg, dest);
             break;
-
-        case ('B'): // short month
-            formatters_.push_back(details::make_unique<details::B_formatter>(padding));
+        case 'b':
+            format_flag_<b_formatter>(op, msg, dest);
             break;
-
-        case ('c'): // datetime
-            formatters_.push_back(details::make_unique<details::c_formatter>(padding));
+        case 'B':
+            format_flag_<B_formatter>(op, msg, dest);
             break;
-
-        case ('C'): // year 2 digits
-            formatters_.push_back(details::make_unique<details::C_formatter>(padding));
+        case 'c':
+            format_flag_<c_formatter>(op, msg, dest);
             break;
-
-        case ('Y'): // year 4 digits
-            formatters_.push_back(details::make_unique<details::Y_formatter>(padding));
+        case 'C':
+            format_flag_<C_formatter>(op, msg, dest);
             break;
-
-        case ('D'):
-        case ('x'): // datetime MM/DD/YY
-            formatters_.push_back(details::make_unique<details::D_formatter>(padding));
+        case 'Y':
+            format_flag_<Y_formatter>(op, msg, dest);
             break;
-
-        case ('m'): // month 1-12
-            formatters_.push_back(details::make_unique<details::m_formatter>(padding));
+        case 'D':
+            format_flag_<D_formatter>(op, msg, dest);
             break;
-
-        case ('d'): // day of month 1-31
-            formatters_.push_back(details::make_unique<details::d_formatter>(padding));
+        case 'm':
+            format_flag_<m_formatter>(op, msg, dest);
             break;
-
-        case ('H'): // hours 24
-            formatters_.push_back(details::make_unique<details::H_formatter>(padding));
+        case 'd':
+            format_flag_<d_formatter>(op, msg, dest);
             break;
-
-        case ('I'): // hours 12
-            formatters_.push_back(details::make_unique<details::I_formatter>(padding));
+        case 'H':
+            format_flag_<H_formatter>(op, msg, dest);
             break;
-
-        case ('M'): // minutes
-            formatters_.push_back(details::make_unique<details::M_formatter>(padding));
+        case 'I':
+            format_flag_<I_formatter>(op, msg, dest);
             break;
-
-        case ('S'): // seconds
-            formatters_.push_back(details::make_unique<details::S_formatter>(padding));
+        case 'M':
+            format_flag_<M_formatter>(op, msg, dest);
             break;
-
-        case ('e'): // milliseconds
-            formatters_.push_back(details::make_unique<details::e_formatter>(padding));
+        case 'S':
+            format_flag_<S_formatter>(op, msg, dest);
             break;
-
-        case ('f'): // microseconds
-            formatters_.push_back(details::make_unique<details::f_formatter>(padding));
+        case 'e':
+            format_flag_<e_formatter>(op, msg, dest);
             break;
-
-        case ('F'): // nanoseconds
-            formatters_.push_back(details::make_unique<details::F_formatter>(padding));
+        case 'f':
+            format_flag_<f_formatter>(op, msg, dest);
             break;
-
-        case ('E'): // seconds since epoch
-            formatters_.push_back(details::make_unique<details::E_formatter>(padding));
+        case 'F':
+            format_flag_<F_formatter>(op, msg, dest);
             break;
-
-        case ('p'): // am/pm
-            formatters_.push_back(details::make_unique<details::p_formatter>(padding));
+        case 'E':
+            format_flag_<E_formatter>(op, msg, dest);
             break;
-
-        case ('r'): // 12 hour clock 02:55:02 pm
-            formatters_.push_back(details::make_unique<details::r_formatter>(padding));
+        case 'p':
+            format_flag_<p_formatter>(op, msg, dest);
             break;
-
-        case ('R'): // 24-hour HH:MM time
-            formatters_.push_back(details::make_unique<details::R_formatter>(padding));
+        case 'r':
+            format_flag_<r_formatter>(op, msg, dest);
             break;
-
-        case ('T'):
-        case ('X'): // ISO 8601 time format (HH:MM:SS)
-            formatters_.push_back(details::make_unique<details::T_formatter>(padding));
+        case 'R':
+            format_flag_<R_formatter>(op, msg, dest);
             break;
-
-        case ('z'): // timezone
-            formatters_.push_back(details::make_unique<details::z_formatter>(padding));
+        case 'T':
+            format_flag_<T_formatter>(op, msg, dest);
             break;
-
-        case ('P'): // pid
-            formatters_.push_back(details::make_unique<details::pid_formatter>(padding));
+        case 'z':
+            format_flag_<z_formatter>(op, msg, dest);
+            break;
+        case 'P':
+            format_flag_<pid_formatter>(op, msg, dest);
             break;
-
 #ifdef SPDLOG_ENABLE_MESSAGE_COUNTER
-        case ('i'):
-            formatters_.push_back(details::make_unique<details::i_formatter>(padding));
+        case 'i':
+            format_flag_<i_formatter>(op, msg, dest);
             break;
 #endif
-        case ('^'): // color range start
-            formatters_.push_back(details::make_unique<details::color_start_formatter>(padding));
+        case '^':
+            format_flag_<color_start_formatter>(op, msg, dest);
             break;
-
-        case ('$'): // color range end
-            formatters_.push_back(details::make_unique<details::color_stop_formatter>(padding));
+        case '$':
+            format_flag_<color_stop_formatter>(op, msg, dest);
             break;
-
-        case ('@'): // source location (filename:filenumber)
-            formatters_.push_back(details::make_unique<details::source_location_formatter>(padding));
+        case '@':
+            format_flag_<source_location_formatter>(op, msg, dest);
             break;
-
-        case ('s'): // source filename
-            formatters_.push_back(details::make_unique<details::source_filename_formatter>(padding));
+        case 's':
+            format_flag_<source_filename_formatter>(op, msg, dest);
             break;
-
-        case ('#'): // source line number
-            formatters_.push_back(details::make_unique<details::source_linenum_formatter>(padding));
+        case '#':
+            format_flag_<source_linenum_formatter>(op, msg, dest);
             break;
+        default:
+            assert(false && "Unexpected pattern op");
+        }
+    }
+
+    // render the runs of date/time flags for the second of the message
+    void render_datetime_runs_(const details::log_msg &msg)
+    {
+        cached_datetime_.clear();
+        for (size_t i = 0; i < ops_.size(); ++i)
+        {
+            auto &op = ops_[i];
+            if (op.flag != details::datetime_run_flag)
+            {
+                continue;
+            }
+            auto &run = datetime_runs_[op.literal_begin];
+            run.text_begin = cached_datetime_.size();
+            format_ops_(&op + 1, &op + 1 + op.literal_size, msg, cached_datetime_);
+            run.text_size = cached_datetime_.size() - run.text_begin;
+            i += op.literal_size;
+        }
+    }
 
-        case ('%'): // % char
-            formatters_.push_back(details::make_unique<details::ch_formatter>('%'));
+    // flags that change at most once a second. the fractions (%e, %f, %F) are formatted per
+    // message, and %+ caches its own date/time part.
+    static bool is_datetime_flag_(char flag)
+    {
+        switch (flag)
+        {
+        case 'a':
+        case 'A':
+        case 'b':
+        case 'B':
+        case 'c':
+        case 'C':
+        case 'Y':
+        case 'D':
+        case 'm':
+        case 'd':
+        case 'H':
+        case 'I':
+        case 'M':
+        case 'S':
+        case 'E':
+        case 'p':
+        case 'r':
+        case 'R':
+        case 'T':
+        case 'z':
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // put each run of date/time flags and the literals between them behind a datetime run op,
+    // so it is rendered once per second (e.g. "[%Y-%m-%d %H:%M:%S." of "[%Y-%m-%d %H:%M:%S.%e] %v").
+    void group_datetime_runs_()
+    {
+        std::vector<details::pattern_op> grouped;
+        grouped.reserve(ops_.size());
+        for (size_t i = 0; i < ops_.size();)
+        {
+            size_t end = i;
+            bool has_datetime = false;
+            while (end < ops_.size() && (ops_[end].flag == '\0' || is_datetime_flag_(ops_[end].flag)))
+            {
+                has_datetime = has_datetime || ops_[end].flag != '\0';
+                ++end;
+            }
+
+            if (!has_datetime)
+            {
+                // a literal run, or a flag that is not a date/time one
+                end = std::max(end, i + 1);
+            }
+            else
+            {
+                details::pattern_op run{};
+                run.flag = details::datetime_run_flag;
+                run.literal_begin = static_cast<uint32_t>(datetime_runs_.size());
+                run.literal_size = static_cast<uint32_t>(end - i);
+                grouped.push_back(run);
+                datetime_runs_.push_back(details::datetime_run{0, 0});
+            }
+            grouped.insert(grouped.end(), ops_.begin() + i, ops_.begin() + end);
+            i = end;
+        }
+        ops_.swap(grouped);
+    }
+
+    // add the op of the flag. aliases are mapped to the flag format_op_(..) knows.
+    void handle_flag_(char flag, details::padding_info padding)
+    {
+        switch (flag)
+        {
+        case 'h': // month
+            flag = 'b';
+            break;
+        case 'x': // datetime MM/DD/YY
+            flag = 'D';
+            break;
+        case 'X': // ISO 8601 time format (HH:MM:SS)
+            flag = 'T';
+            break;
+        case '+': // default formatter
+        case 'n': // logger name
+        case 'l': // level
+        case 'L': // short level
+        case 't': // thread id
+        case 'v': // the message text
+        case 'a': // weekday
+        case 'A': // short weekday
+        case 'b': // month
+        case 'B': // short month
+        case 'c': // datetime
+        case 'C': // year 2 digits
+        case 'Y': // year 4 digits
+        case 'D': // datetime MM/DD/YY
+        case 'm': // month 1-12
+        case 'd': // day of month 1-31
+        case 'H': // hours 24
+        case 'I': // hours 12
+        case 'M': // minutes
+        case 'S': // seconds
+        case 'e': // milliseconds
+        case 'f': // microseconds
+        case 'F': // nanoseconds
+        case 'E': // seconds since epoch
+        case 'p': // am/pm
+        case 'r': // 12 hour clock 02:55:02 pm
+        case 'R': // 24-hour HH:MM time
+        case 'T': // ISO 8601 time format (HH:MM:SS)
+        case 'z': // timezone
+        case 'P': // pid
+#ifdef SPDLOG_ENABLE_MESSAGE_COUNTER
+        case 'i':
+#endif
+        case '^': // color range start
+        case '$': // color range end
+        case '@': // source location (filename:filenumber)
+        case 's': // source filename
+        case '#': // source line number
             break;
 
+        case '%': // % char
+            add_literal_('%');
+            return;
+
         default: // Unknown flag appears as is
-            auto unknown_flag = details::make_unique<details::aggregate_formatter>();
-            unknown_flag->add_ch('%');
-            unknown_flag->add_ch(flag);
-            formatters_.push_back((std::move(unknown_flag)));
-            break;
+            add_literal_('%');
+            add_literal_(flag);
+            return;
+        }
+        add_op_(flag, padding);
+    }
+
+    void add_op_(char flag, details::padding_info padding)
+    {
+        details::pattern_op op{};
+        op.flag = flag;
+        op.pad_side = static_cast<unsigned char>(padding.side_);
+        op.pad_width = static_cast<unsigned char>(padding.width_);
+        ops_.push_back(op);
+    }
+
+    // append the char to the literal run of the last op (or to a new one)
+    void add_literal_(char ch)
+    {
+        if (ops_.empty() || ops_.back().flag != '\0')
+        {
+            details::pattern_op op{};
+            op.literal_begin = static_cast<uint32_t>(literals_.size());
+            ops_.push_back(op);
         }
+        literals_.push_back(ch);
+        ops_.back().literal_size++;
     }
 
     // Extract given pad spec (e.g. %8X)
@@ -1276,17 +1551,12 @@ private:
     void compile_pattern_(const std::string &pattern)
     {
         auto end = pattern.end();
-        std::unique_ptr<details::aggregate_formatter> user_chars;
-        formatters_.clear();
+        ops_.clear();
+        literals_.clear();
         for (auto it = pattern.begin(); it != end; ++it)
         {
             if (*it == '%')
             {
-                if (user_chars) // append user chars found so far
-                {
-                    formatters_.push_back(std::move(user_chars));
-                }
-
                 auto padding = handle_padspec_(++it, end);
 
                 if (it != end)
@@ -1300,17 +1570,9 @@ private:
             }
             else // chars not following the % sign should be displayed as is
             {
-                if (!user_chars)
-                {
-                    user_chars = details::make_unique<details::aggregate_formatter>();
-                }
-                user_chars->add_ch(*it);
+                add_literal_(*it);
             }
         }
-        if (user_chars) // append raw chars found so far
-        {
-            formatters_.push_back(std::move(user_chars));
-        }
     }
 };
 } // namespace spdlog
@@ -0,0 +1,416 @@
+#pragma once
+
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// multi producer-multi consumer blocking queue made of one ring per producing thread.
+// each thread lazily gets its own lockfree_ring (holding up to max_items) the first
+// time it enqueues, so producers never write to a cache line shared with other producers.
+// the async_queue_memory options apply to each ring when it is created.
+// consumers are serialized and merge the rings by the items' "time" member,
+// so T must have a "time" member that supports operator<.
+// enqueue(..) - will block until room found in the calling thread's ring.
+// enqueue_nowait(..) - will overrun the oldest message of the calling thread's ring if
+// no room left.
+// enqueue_for(..) - will block up to a timeout until room found in the calling thread's ring.
+// try_enqueue(..) - will give up right away if no room left in the calling thread's ring.
+// enqueue_bulk(..) - same as enqueue(..) for several items, waking up consumers once.
+// dequeue_for(..) - will block until any ring is not empty or timeout have passed.
+// a zero timeout makes it return right away.
+// dequeue_bulk_for(..) - same as dequeue_for(..), but merges up to max_items items
+// under a single lock.
+
+#include "spdlog/common.h"
+#include "spdlog/details/lockfree_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(SPDLOG_NO_TLS)
+#error per_thread_blocking_queue requires thread local storage (SPDLOG_NO_TLS is defined)
+#endif
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class per_thread_blocking_queue
+{
+public:
+    using item_type = T;
+    explicit per_thread_blocking_queue(size_t max_items, const async_queue_memory &memory = async_queue_memory())
+        : max_items_(max_items)
+        , memory_(memory)
+        , id_(next_queue_id_())
+    {
+    }
+
+    per_thread_blocking_queue(const per_thread_blocking_queue &) = delete;
+    per_thread_blocking_queue &operator=(const per_thread_blocking_queue &) = delete;
+
+    // try to enqueue and block if no room left in this thread's ring.
+    // on_wait(duration) is called with the time it was blocked (if it was).
+    template<typename OnWait = no_queue_hook>
+    void enqueue(T &&item, OnWait on_wait = OnWait())
+    {
+        auto &ring = thread_ring_().ring;
+        if (!ring.try_push(std::move(item)))
+        {
+            auto wait_start = queue_wait_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                waiting_producers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                pop_cv_.wait(lock, [&ring, &item] { return ring.try_push(std::move(item)); });
+                waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            notify_consumer_();
+            on_wait(queue_wait_clock::now() - wait_start);
+            return;
+        }
+        notify_consumer_();
+    }
+
+    // try to enqueue and block up to timeout if no room left.
+    // return false (and leave the item untouched) if it timed out.
+    template<typename OnWait = no_queue_hook>
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout, OnWait on_wait = OnWait())
+    {
+        auto &ring = thread_ring_().ring;
+        if (!ring.try_push(std::move(item)))
+        {
+            auto wait_start = queue_wait_clock::now();
+            bool pushed;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                waiting_producers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                pushed = pop_cv_.wait_for(lock, timeout, [&ring, &item] { return ring.try_push(std::move(item)); });
+                waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            on_wait(queue_wait_clock::now() - wait_start);
+            if (!pushed)
+            {
+                return false;
+            }
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // enqueue if there is room. return false (and leave the item untouched) if not.
+    // takes no lock.
+    bool try_enqueue(T &&item)
+    {
+        auto &ring = thread_ring_().ring;
+        if (!ring.try_push(std::move(item)))
+        {
+            return false;
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // enqueue the items in order, notifying consumers once (unless it has to wait for room).
+    template<typename OnWait = no_queue_hook>
+    void enqueue_bulk(T *items, size_t n, OnWait on_wait = OnWait())
+    {
+        auto &ring = thread_ring_().ring;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!ring.try_push(std::move(items[i])))
+            {
+                notify_consumer_();
+                enqueue(std::move(items[i]), on_wait);
+            }
+        }
+        notify_consumer_();
+    }
+
+    // enqueue immediately. overrun oldest message in this thread's ring if no room left.
+    // on_overrun(item) is called with each overrun item.
+    template<typename OnOverrun = no_queue_hook>
+    void enqueue_nowait(T &&item, OnOverrun on_overrun = OnOverrun())
+    {
+        auto &ring = thread_ring_().ring;
+        while (!ring.try_push(std::move(item)))
+        {
+            T discarded;
+            if (ring.try_pop(discarded))
+            {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+                on_overrun(static_cast<const T &>(discarded));
+            }
+        }
+        notify_consumer_();
+    }
+
+    // try to dequeue the oldest item of all rings. if no item found. wait upto timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!pop_oldest_(popped_item))
+            {
+                if (wait_duration <= std::chrono::milliseconds::zero())
+                {
+                    return false;
+                }
+                waiting_consumers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool dequeued = push_cv_.wait_for(lock, wait_duration, [this, &popped_item] { return this->pop_oldest_(popped_item); });
+                waiting_consumers_.fetch_sub(1, std::memory_order_relaxed);
+                if (!dequeued)
+                {
+                    return false;
+                }
+            }
+        }
+        notify_producers_();
+        return true;
+    }
+
+    // try to dequeue up to max_items items (oldest first). if no item found. wait upto timeout and try again
+    // Return the number of dequeued items (0 if timed out)
+    size_t dequeue_bulk_for(T *popped_items, size_t max_items, std::chrono::milliseconds wait_duration)
+    {
+        if (max_items == 0)
+        {
+            return 0;
+        }
+        size_t popped = 0;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!pop_oldest_(popped_items[0]))
+            {
+                if (wait_duration <= std::chrono::milliseconds::zero())
+                {
+                    return 0;
+                }
+                waiting_consumers_.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool dequeued = push_cv_.wait_for(lock, wait_duration, [this, popped_items] { return this->pop_oldest_(popped_items[0]); });
+                waiting_consumers_.fetch_sub(1, std::memory_order_relaxed);
+                if (!dequeued)
+                {
+                    return 0;
+                }
+            }
+            popped = 1;
+            while (popped < max_items && pop_oldest_(popped_items[popped]))
+            {
+                popped++;
+            }
+        }
+        notify_producers_();
+        return popped;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // ring of a single producing thread.
+    // staged holds the ring's oldest item once a consumer popped it for merging
+    // (accessed only by consumers, under queue_mutex_).
+    struct producer_ring
+    {
+        producer_ring(size_t max_items, const async_queue_memory &memory)
+            : ring(max_items, memory)
+        {
+        }
+        lockfree_ring<T> ring;
+        T staged;
+        bool has_staged = false;
+    };
+
+    struct tls_entry
+    {
+        size_t queue_id;
+        std::shared_ptr<producer_ring> ring;
+    };
+
+    // last ring used by the thread (trivially destructible, so it is still usable
+    // after the thread's other thread local objects were destroyed at exit).
+    struct thread_cache
+    {
+        size_t queue_id = 0;
+        producer_ring *ring = nullptr;
+        bool exiting = false;
+    };
+
+    // rings owned by the thread - one per queue it enqueued to.
+    struct thread_rings
+    {
+        std::vector<tls_entry> entries;
+        ~thread_rings()
+        {
+            auto &cache = thread_cache_();
+            cache.queue_id = 0;
+            cache.ring = nullptr;
+            cache.exiting = true;
+        }
+    };
+
+    static thread_cache &thread_cache_()
+    {
+        static thread_local thread_cache cache;
+        return cache;
+    }
+
+    static size_t next_queue_id_()
+    {
+        static std::atomic<size_t> last_id{0};
+        return last_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // return the calling thread's ring, creating and registering it on first use.
+    // the thread keeps a shared_ptr to it until it exits, the queue until it is drained.
+    producer_ring &thread_ring_()
+    {
+        auto &cache = thread_cache_();
+        if (cache.queue_id == id_)
+        {
+            return *cache.ring;
+        }
+
+        // the thread is exiting (e.g. a static destructor in the main thread) and its rings are gone
+        if (cache.exiting)
+        {
+            return shared_ring_();
+        }
+
+        static thread_local thread_rings rings;
+        producer_ring *found = nullptr;
+        for (auto &entry : rings.entries)
+        {
+            if (entry.queue_id == id_)
+            {
+                found = entry.ring.get();
+                break;
+            }
+        }
+
+        if (found == nullptr)
+        {
+            // forget rings of queues that no longer exist
+            auto &entries = rings.entries;
+            for (auto it = entries.begin(); it != entries.end();)
+            {
+                it = it->ring.use_count() == 1 ? entries.erase(it) : it + 1;
+            }
+
+            auto new_ring = std::make_shared<producer_ring>(max_items_, memory_);
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                rings_.push_back(new_ring);
+            }
+            found = new_ring.get();
+            entries.push_back(tls_entry{id_, std::move(new_ring)});
+        }
+
+        cache.queue_id = id_;
+        cache.ring = found;
+        return *found;
+    }
+
+    // ring shared by all threads that enqueue while exiting.
+    // (lockfree_ring supports multiple producers, so this is safe - just not contention free)
+    producer_ring &shared_ring_()
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (shared_ring_ptr_ == nullptr)
+        {
+            shared_ring_ptr_ = std::make_shared<producer_ring>(max_items_, memory_);
+            rings_.push_back(shared_ring_ptr_);
+        }
+        return *shared_ring_ptr_;
+    }
+
+    // k-way merge: pop the item with the smallest time among the heads of all rings.
+    // rings whose thread has exited are removed once they are drained.
+    // must be called under queue_mutex_.
+    bool pop_oldest_(T &popped_item)
+    {
+        producer_ring *oldest = nullptr;
+        for (auto it = rings_.begin(); it != rings_.end();)
+        {
+            auto &pr = **it;
+            if (!pr.has_staged)
+            {
+                pr.has_staged = pr.ring.try_pop(pr.staged);
+            }
+
+            if (!pr.has_staged)
+            {
+                // producer thread is gone and nothing left - release the ring
+                it = it->use_count() == 1 && pr.ring.empty() ? rings_.erase(it) : it + 1;
+                continue;
+            }
+
+            if (oldest == nullptr || pr.staged.time < oldest->staged.time)
+            {
+                oldest = &pr;
+            }
+            ++it;
+        }
+
+        if (oldest == nullptr)
+        {
+            return false;
+        }
+        popped_item = std::move(oldest->staged);
+        oldest->has_staged = false;
+        return true;
+    }
+
+    // the fences pair with the ones taken before parking: either the parked side sees
+    // the new state of the ring, or we see it waiting and wake it up.
+    void notify_consumer_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_consumers_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+            }
+            push_cv_.notify_one();
+        }
+    }
+
+    // parked producers wait for room in their own ring, so wake them all
+    void notify_producers_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_producers_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+            }
+            pop_cv_.notify_all();
+        }
+    }
+
+    const size_t max_items_;
+    const async_queue_memory memory_;
+    const size_t id_;
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    std::vector<std::shared_ptr<producer_ring>> rings_;
+    std::shared_ptr<producer_ring> shared_ring_ptr_;
+    std::atomic<size_t> waiting_consumers_{0};
+    std::atomic<size_t> waiting_producers_{0};
+    std::atomic<size_t> overrun_counter_{0};
+};
+} // namespace details
+} // namespace spdlog
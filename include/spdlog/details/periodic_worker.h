@@ -9,9 +9,11 @@
 // periodic worker thread - periodically executes the given callback function.
 //
 // RAII over the owned thread:
-//    creates the thread on construction.
+//    creates the thread on construction (with the given thread_options applied).
 //    stops and joins the thread on destruction (if the thread is executing a callback, wait for it to finish first).
 
+#include "spdlog/details/thread_starter.h"
+
 #include <chrono>
 #include <condition_variable>
 #include <functional>
@@ -23,7 +25,7 @@ namespace details {
 class periodic_worker
 {
 public:
-    periodic_worker(const std::function<void()> &callback_fun, std::chrono::seconds interval)
+    periodic_worker(const std::function<void()> &callback_fun, std::chrono::seconds interval, const thread_options &options = thread_options())
     {
         active_ = (interval > std::chrono::seconds::zero());
         if (!active_)
@@ -31,7 +33,7 @@ public:
             return;
         }
 
-        worker_thread_ = std::thread([this, callback_fun, interval]() {
+        worker_thread_ = start_thread(options, 0, false, [this, callback_fun, interval]() {
             for (;;)
             {
                 std::unique_lock<std::mutex> lock(this->mutex_);
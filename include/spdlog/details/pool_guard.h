@@ -0,0 +1,182 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// lets producers post to a thread pool through a plain pointer, without touching
+// the pool's shared_ptr control block (a cache line written by every producer)
+// on each message.
+// a producer thread publishes the pool it is about to use in a slot of its own,
+// then checks (read only) that the pool's shared_ptr count is not zero yet.
+// the pool's destructor runs once the count is zero, and calls wait_unused(..)
+// before tearing anything down - so either the producer sees the pool is gone,
+// or the destructor sees the producer and waits for it.
+// threads that are exiting (their thread locals are destroyed) or builds without
+// thread local storage fall back to locking the weak_ptr.
+#pragma once
+
+#include "spdlog/common.h"
+#include "spdlog/details/lockfree_ring.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+class pool_slots
+{
+public:
+    // slot of a single thread, on a cache line of its own
+    struct slot
+    {
+        char pad[cache_line_size];
+        std::atomic<const void *> pool{nullptr};
+        std::atomic<bool> owned{true};
+        slot *next = nullptr;
+        char pad_after[cache_line_size];
+    };
+
+    // the calling thread's slot (nullptr if not available)
+    static slot *this_thread_slot()
+    {
+#if defined(SPDLOG_NO_TLS)
+        return nullptr;
+#else
+        auto &cache = thread_cache_();
+        if (cache.current != nullptr || cache.exiting)
+        {
+            return cache.current;
+        }
+        static thread_local slot_owner owner;
+        owner.owned_slot = acquire_();
+        cache.current = owner.owned_slot;
+        return cache.current;
+#endif
+    }
+
+    // wait until no thread is using the given pool
+    static void wait_unused(const void *pool)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto *s = head_().load(std::memory_order_acquire); s != nullptr; s = s->next)
+        {
+            while (s->pool.load(std::memory_order_seq_cst) == pool)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+#if !defined(SPDLOG_NO_TLS)
+    // trivially destructible, so it is still usable after the thread's other
+    // thread local objects were destroyed at exit.
+    struct thread_cache
+    {
+        slot *current = nullptr;
+        bool exiting = false;
+    };
+
+    // gives the thread's slot back for reuse by other threads when the thread exits
+    struct slot_owner
+    {
+        slot *owned_slot = nullptr;
+        ~slot_owner()
+        {
+            auto &cache = thread_cache_();
+            cache.current = nullptr;
+            cache.exiting = true;
+            if (owned_slot != nullptr)
+            {
+                owned_slot->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static thread_cache &thread_cache_()
+    {
+        static thread_local thread_cache cache;
+        return cache;
+    }
+#endif
+
+    // list of all slots ever created. slots are never freed (only reused), so the
+    // list can be walked without a lock - even during static destruction.
+    static std::atomic<slot *> &head_()
+    {
+        static std::atomic<slot *> head{nullptr};
+        return head;
+    }
+
+    static slot *acquire_()
+    {
+        auto &head = head_();
+        for (auto *s = head.load(std::memory_order_acquire); s != nullptr; s = s->next)
+        {
+            bool expected = false;
+            if (!s->owned.load(std::memory_order_relaxed) && s->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return s;
+            }
+        }
+
+        auto *new_slot = new slot();
+        new_slot->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(new_slot->next, new_slot, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+        return new_slot;
+    }
+};
+
+// use of a pool by the calling thread, for the lifetime of the guard
+template<typename Pool>
+class pool_guard
+{
+public:
+    pool_guard(Pool *pool, const std::weak_ptr<Pool> &weak_pool)
+        : slot_(pool_slots::this_thread_slot())
+    {
+        if (slot_ == nullptr)
+        {
+            locked_ = weak_pool.lock();
+            pool_ = locked_.get();
+            return;
+        }
+
+        prev_ = slot_->pool.load(std::memory_order_relaxed);
+        slot_->pool.store(pool, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!weak_pool.expired())
+        {
+            pool_ = pool;
+        }
+    }
+
+    ~pool_guard()
+    {
+        if (slot_ != nullptr)
+        {
+            slot_->pool.store(prev_, std::memory_order_release);
+        }
+    }
+
+    pool_guard(const pool_guard &) = delete;
+    pool_guard &operator=(const pool_guard &) = delete;
+
+    // nullptr if the pool doesn't exist anymore
+    Pool *get() const
+    {
+        return pool_;
+    }
+
+private:
+    pool_slots::slot *slot_;
+    const void *prev_ = nullptr;
+    Pool *pool_ = nullptr;
+    std::shared_ptr<Pool> locked_;
+};
+} // namespace details
+} // namespace spdlog
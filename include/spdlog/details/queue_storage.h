@@ -0,0 +1,136 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// fixed size array of default constructed items that holds the items of a queue.
+// by default it is a plain new[]. if any of the async_queue_memory options is set, the
+// items live in pages allocated from the os, which are prefaulted/huge/locked as requested.
+#pragma once
+
+#include "spdlog/common.h"
+#include "spdlog/details/os.h"
+
+#include <chrono>
+#include <cstddef>
+#include <new>
+
+namespace spdlog {
+namespace details {
+
+// default for the hooks the queues call on their slow paths:
+// on_wait(waited) once a producer waited for room, on_overrun(..) for each dropped item.
+struct no_queue_hook
+{
+    template<typename... Args>
+    void operator()(Args &&...) const
+    {
+    }
+};
+
+using queue_wait_clock = std::chrono::steady_clock;
+
+template<typename T>
+class queue_storage
+{
+public:
+    explicit queue_storage(size_t n, const async_queue_memory &memory = async_queue_memory())
+        : size_(n)
+    {
+        if (!memory.prefault && !memory.huge_pages && !memory.lock)
+        {
+            items_ = new T[n];
+            return;
+        }
+
+        region_bytes_ = n * sizeof(T);
+        region_ = os::alloc_pages(region_bytes_, memory.huge_pages);
+        try
+        {
+            if (memory.lock)
+            {
+                os::lock_pages(region_, region_bytes_); // also faults the pages in
+            }
+            else if (memory.prefault)
+            {
+                os::prefault_pages(region_, region_bytes_);
+            }
+            construct_items_();
+        }
+        catch (...)
+        {
+            os::free_pages(region_, region_bytes_);
+            throw;
+        }
+    }
+
+    queue_storage(const queue_storage &) = delete;
+    queue_storage &operator=(const queue_storage &) = delete;
+
+    ~queue_storage()
+    {
+        if (region_ == nullptr)
+        {
+            delete[] items_;
+            return;
+        }
+        destroy_items_(size_);
+        os::free_pages(region_, region_bytes_); // munlock-ed implicitly
+    }
+
+    T &operator[](size_t i)
+    {
+        return items_[i];
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return items_[i];
+    }
+
+    T *data()
+    {
+        return items_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    void construct_items_()
+    {
+        auto *items = static_cast<T *>(region_);
+        size_t constructed = 0;
+        try
+        {
+            for (; constructed < size_; constructed++)
+            {
+                new (items + constructed) T();
+            }
+        }
+        catch (...)
+        {
+            items_ = items;
+            destroy_items_(constructed);
+            throw;
+        }
+        items_ = items;
+    }
+
+    void destroy_items_(size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            items_[i].~T();
+        }
+    }
+
+    size_t size_;
+    T *items_ = nullptr;
+    void *region_ = nullptr;
+    size_t region_bytes_ = 0;
+};
+} // namespace details
+} // namespace spdlog
@@ -25,6 +25,7 @@
 
 #include <chrono>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -104,9 +105,17 @@ public:
     }
 
     void set_tp(std::shared_ptr<thread_pool> tp)
+    {
+        set_tp(std::move(tp), nullptr);
+    }
+
+    // drain_tp: how shutdown(..) drains the pool (see thread_pool::drain(..)).
+    // passed in by async.h, since the registry doesn't depend on thread_pool.h.
+    void set_tp(std::shared_ptr<thread_pool> tp, std::function<size_t(std::chrono::milliseconds)> drain_tp)
     {
         std::lock_guard<std::recursive_mutex> lock(tp_mutex_);
         tp_ = std::move(tp);
+        drain_tp_ = std::move(drain_tp);
     }
 
     std::shared_ptr<thread_pool> get_tp()
@@ -146,11 +155,11 @@ public:
         flush_level_ = log_level;
     }
 
-    void flush_every(std::chrono::seconds interval)
+    void flush_every(std::chrono::seconds interval, const thread_options &options = thread_options())
     {
         std::lock_guard<std::mutex> lock(flusher_mutex_);
         std::function<void()> clbk = std::bind(&registry::flush_all, this);
-        periodic_flusher_ = details::make_unique<periodic_worker>(clbk, interval);
+        periodic_flusher_ = details::make_unique<periodic_worker>(clbk, interval, options);
     }
 
     void set_error_handler(log_err_handler handler)
@@ -181,6 +190,30 @@ public:
         }
     }
 
+    // flush all loggers at once, then wait until each is done (async loggers included)
+    void flush_all_and_wait()
+    {
+        std::vector<std::future<void>> flushed;
+        {
+            std::lock_guard<std::mutex> lock(logger_map_mutex_);
+            for (auto &l : loggers_)
+            {
+                flushed.push_back(l.second->flush_with_future());
+            }
+        }
+        for (auto &f : flushed)
+        {
+            try
+            {
+                f.get();
+            }
+            catch (const std::future_error &)
+            {
+                // the flush failed (already reported by the logger) or was dropped
+            }
+        }
+    }
+
     void drop(const std::string &logger_name)
     {
         std::lock_guard<std::mutex> lock(logger_map_mutex_);
@@ -198,20 +231,33 @@ public:
         default_logger_.reset();
     }
 
-    // clean all resources and threads started by the registry
-    void shutdown()
+    // clean all resources and threads started by the registry: stop the periodic flusher,
+    // drain the thread pool within drain_timeout (everything by default) and drop all loggers.
+    // return the number of async log messages discarded by the drain.
+    size_t shutdown(std::chrono::milliseconds drain_timeout = std::chrono::milliseconds::max())
     {
         {
             std::lock_guard<std::mutex> lock(flusher_mutex_);
             periodic_flusher_.reset();
         }
 
+        std::shared_ptr<thread_pool> tp;
+        std::function<size_t(std::chrono::milliseconds)> drain_tp;
+        {
+            std::lock_guard<std::recursive_mutex> lock(tp_mutex_);
+            tp = tp_;
+            drain_tp = drain_tp_;
+        }
+        size_t discarded = drain_tp ? drain_tp(drain_timeout) : 0;
+
         drop_all();
 
         {
             std::lock_guard<std::recursive_mutex> lock(tp_mutex_);
             tp_.reset();
+            drain_tp_ = nullptr;
         }
+        return discarded;
     }
 
     std::recursive_mutex &tp_mutex()
@@ -276,6 +322,7 @@ private:
     level::level_enum flush_level_ = level::off;
     log_err_handler err_handler_;
     std::shared_ptr<thread_pool> tp_;
+    std::function<size_t(std::chrono::milliseconds)> drain_tp_;
     std::unique_ptr<periodic_worker> periodic_flusher_;
     std::shared_ptr<logger> default_logger_;
     bool automatic_registration_ = true;
@@ -0,0 +1,63 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// the formatted text of a log message, shared by the sinks of a logger (see sink::log_shared(..)).
+// sinks whose formatters have the same formatter::format_key() get the same text - so it is
+// formatted once for all of them.
+// it keeps the text of the last formatter only, which is enough for sinks in a row with the
+// same pattern (the common case) - an odd sink in between costs one more format.
+
+#include "spdlog/details/log_msg.h"
+#include "spdlog/fmt/fmt.h"
+#include "spdlog/formatter.h"
+
+namespace spdlog {
+namespace details {
+
+class shared_format
+{
+public:
+    explicit shared_format(const log_msg &msg)
+        : msg_(msg)
+    {
+    }
+
+    shared_format(const shared_format &) = delete;
+    shared_format &operator=(const shared_format &) = delete;
+
+    // the message formatted by the given formatter (called under the lock of its sink).
+    // the key is copied - formatters of other sinks may be replaced once their lock is released.
+    const fmt::memory_buffer &format(formatter &msg_formatter)
+    {
+        auto key = msg_formatter.format_key();
+        if (key.size() > 0 && key == string_view_t(key_.data(), key_.size()))
+        {
+            // the color range is set by the formatter - as if it formatted the message
+            msg_.color_range_start = color_range_start_;
+            msg_.color_range_end = color_range_end_;
+            return formatted_;
+        }
+
+        formatted_.clear();
+        msg_formatter.format(msg_, formatted_);
+        color_range_start_ = msg_.color_range_start;
+        color_range_end_ = msg_.color_range_end;
+        key_.clear();
+        key_.append(key.data(), key.data() + key.size());
+        return formatted_;
+    }
+
+private:
+    const log_msg &msg_;
+    fmt::memory_buffer formatted_;
+    fmt::basic_memory_buffer<char, 128> key_;
+    size_t color_range_start_ = 0;
+    size_t color_range_end_ = 0;
+};
+
+} // namespace details
+} // namespace spdlog
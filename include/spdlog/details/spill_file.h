@@ -0,0 +1,243 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// overflow file of an async queue (see async_overflow_policy::spill).
+// messages are appended as length prefixed binary records, and read back in the same
+// order. the file is active from the first append until all its records were read,
+// then it starts over from its beginning (it keeps its largest size until destroyed).
+// while active, all the messages of the queue go through it - so they keep their order.
+// records point to live loggers, quotas and flush promises - so they can only be
+// replayed by the process that wrote them, and the file is removed when destroyed.
+
+#include "spdlog/common.h"
+#include "spdlog/details/async_msg.h"
+#include "spdlog/details/os.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <mutex>
+
+namespace spdlog {
+namespace details {
+
+class spill_file
+{
+public:
+    enum class outcome
+    {
+        appended,
+        posted,
+        skipped
+    };
+
+    spill_file() = default;
+    spill_file(const spill_file &) = delete;
+    spill_file &operator=(const spill_file &) = delete;
+
+    ~spill_file()
+    {
+        if (fd_ != nullptr)
+        {
+            // break the flush promises of the records that were never read
+            async_msg msg;
+            while (read_pos_ < write_pos_ && read_one_(msg)) {}
+            std::fclose(fd_);
+            os::remove(filename_);
+        }
+    }
+
+    // the file is created on first use. throws spdlog_ex if it was set already.
+    void set_filename(filename_t filename)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (enabled_.load(std::memory_order_relaxed))
+        {
+            throw spdlog_ex("spill file already set to " + os::filename_to_str(filename_));
+        }
+        filename_ = std::move(filename);
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const
+    {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    // whether it holds records that were not read yet
+    bool active() const
+    {
+        return active_.load(std::memory_order_relaxed);
+    }
+
+    // whether the consumers of the queue may find records in it - they must not park then.
+    // pairs with the fence in spill(..): either a consumer sees the producer at work, or the
+    // producer's last try to post sees the room made by the consumer.
+    bool busy() const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return active_.load(std::memory_order_relaxed) || appending_.load(std::memory_order_relaxed) > 0;
+    }
+
+    // called by producers that found the spill active, or their queue full (if_full).
+    // append the message if the spill is still active. otherwise, if_full tries try_post(msg)
+    // once more and appends the message if the queue is still full.
+    // skipped: the message is untouched, and should be posted as usual.
+    // throws spdlog_ex if the file can't be written (and the message is untouched).
+    template<typename TryPost>
+    outcome spill(async_msg &msg, bool if_full, TryPost try_post)
+    {
+        appending_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        struct appending_guard
+        {
+            std::atomic<size_t> &appending;
+            ~appending_guard()
+            {
+                appending.fetch_sub(1, std::memory_order_relaxed);
+            }
+        } guard{appending_};
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_.load(std::memory_order_relaxed))
+        {
+            if (!if_full)
+            {
+                return outcome::skipped;
+            }
+            if (try_post(msg))
+            {
+                return outcome::posted;
+            }
+        }
+        append_(msg);
+        return outcome::appended;
+    }
+
+    // read up to max_items records, in the order they were appended.
+    // a record that can't be read is lost, with the ones after it.
+    size_t read(async_msg *items, size_t max_items)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = 0;
+        while (n < max_items && read_pos_ < write_pos_)
+        {
+            if (!read_one_(items[n]))
+            {
+                read_pos_ = write_pos_;
+                break;
+            }
+            n++;
+        }
+        if (read_pos_ == write_pos_)
+        {
+            read_pos_ = write_pos_ = 0;
+            active_.store(false, std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+private:
+    struct record_header
+    {
+        size_t payload_size;
+        async_msg_type msg_type;
+        level::level_enum level;
+        log_clock::time_point time;
+        size_t thread_id;
+        size_t msg_id;
+        source_loc source;
+        async_logger_ptr worker_ptr;
+        deferred_format_fn deferred_fn;
+        async_quota *quota;
+        std::promise<void> *flushed; // owned by the record
+    };
+
+    // under the lock
+    void append_(async_msg &msg)
+    {
+        open_();
+        record_header header{msg.raw.size(), msg.msg_type, msg.level, msg.time, msg.thread_id, msg.msg_id, msg.source, msg.worker_ptr,
+            msg.deferred_fn, msg.quota, msg.flushed.get()};
+        seek_(write_pos_, true);
+        if (std::fwrite(&header, sizeof(header), 1, fd_) != 1 ||
+            (header.payload_size > 0 && std::fwrite(msg.raw.data(), header.payload_size, 1, fd_) != 1))
+        {
+            // whatever was written is overwritten by the next record
+            pos_ = -1;
+            throw spdlog_ex("Failed writing to spill file " + os::filename_to_str(filename_), errno);
+        }
+        msg.flushed.release();
+        write_pos_ += static_cast<long>(sizeof(header) + header.payload_size);
+        pos_ = write_pos_;
+        active_.store(true, std::memory_order_relaxed);
+    }
+
+    void open_()
+    {
+        if (fd_ == nullptr && os::fopen_s(&fd_, filename_, SPDLOG_FILENAME_T("w+b")))
+        {
+            fd_ = nullptr;
+            throw spdlog_ex("Failed opening spill file " + os::filename_to_str(filename_), errno);
+        }
+    }
+
+    // the stream is shared by reads and writes - it must be positioned when switching
+    void seek_(long pos, bool writing)
+    {
+        if (pos_ != pos || writing_ != writing)
+        {
+            std::fseek(fd_, pos, SEEK_SET);
+            pos_ = pos;
+            writing_ = writing;
+        }
+    }
+
+    bool read_one_(async_msg &msg)
+    {
+        record_header header;
+        seek_(read_pos_, false);
+        if (std::fread(&header, sizeof(header), 1, fd_) != 1)
+        {
+            pos_ = -1;
+            return false;
+        }
+        msg.msg_type = header.msg_type;
+        msg.level = header.level;
+        msg.time = header.time;
+        msg.thread_id = header.thread_id;
+        msg.msg_id = header.msg_id;
+        msg.source = header.source;
+        msg.worker_ptr = header.worker_ptr;
+        msg.deferred_fn = header.deferred_fn;
+        msg.quota = header.quota;
+        msg.flushed.reset(header.flushed);
+        msg.raw.resize(header.payload_size);
+        if (header.payload_size > 0 && std::fread(msg.raw.data(), header.payload_size, 1, fd_) != 1)
+        {
+            pos_ = -1;
+            return false;
+        }
+        read_pos_ += static_cast<long>(sizeof(header) + header.payload_size);
+        pos_ = read_pos_;
+        return true;
+    }
+
+    filename_t filename_;
+    std::mutex mutex_;
+    std::FILE *fd_ = nullptr;
+    long write_pos_ = 0;
+    long read_pos_ = 0;
+    long pos_ = -1; // position of fd_ (-1 if unknown)
+    bool writing_ = false;
+    std::atomic<bool> enabled_{false};
+    std::atomic<size_t> appending_{0};
+    std::atomic<bool> active_{false};
+};
+
+} // namespace details
+} // namespace spdlog
@@ -1,236 +1,1705 @@
 #pragma once
 
-#include "spdlog/details/fmt_helper.h"
+#include "spdlog/details/async_msg.h"
+#include "spdlog/details/async_quota.h"
 #include "spdlog/details/log_msg.h"
+#if defined(SPDLOG_BYTE_RING_QUEUE)
+#include "spdlog/details/byte_ring_q.h"
+#elif defined(SPDLOG_PER_THREAD_QUEUE)
+#include "spdlog/details/per_thread_q.h"
+#elif defined(SPDLOG_LOCKFREE_QUEUE)
+#include "spdlog/details/lockfree_blocking_q.h"
+#else
 #include "spdlog/details/mpmc_blocking_q.h"
+#endif
 #include "spdlog/details/os.h"
+#include "spdlog/details/pool_guard.h"
+#include "spdlog/details/spill_file.h"
+#include "spdlog/details/thread_starter.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace spdlog {
 namespace details {
 
-using async_logger_ptr = std::shared_ptr<spdlog::async_logger>;
-
-enum class async_msg_type
-{
-    log,
-    flush,
-    terminate
-};
-
-// Async msg to move to/from the queue
-// Movable only. should never be copied
-struct async_msg
+class thread_pool
 {
-    async_msg_type msg_type;
-    level::level_enum level;
-    log_clock::time_point time;
-    size_t thread_id;
-    fmt::basic_memory_buffer<char, 176> raw;
-
-    size_t msg_id;
-    source_loc source;
-    async_logger_ptr worker_ptr;
-
-    async_msg() = default;
-    ~async_msg() = default;
-
-    // should only be moved in or out of the queue..
-    async_msg(const async_msg &) = delete;
-
-// support for vs2013 move
-#if defined(_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&other) SPDLOG_NOEXCEPT : msg_type(other.msg_type),
-                                                   level(other.level),
-                                                   time(other.time),
-                                                   thread_id(other.thread_id),
-                                                   raw(move(other.raw)),
-                                                   msg_id(other.msg_id),
-                                                   source(other.source),
-                                                   worker_ptr(std::move(other.worker_ptr))
-    {
-    }
-
-    async_msg &operator=(async_msg &&other) SPDLOG_NOEXCEPT
-    {
-        msg_type = other.msg_type;
-        level = other.level;
-        time = other.time;
-        thread_id = other.thread_id;
-        raw = std::move(other.raw);
-        msg_id = other.msg_id;
-        source = other.source;
-        worker_ptr = std::move(other.worker_ptr);
-        return *this;
-    }
-#else // (_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&) = default;
-    async_msg &operator=(async_msg &&) = default;
+public:
+    using item_type = async_msg;
+#if defined(SPDLOG_BYTE_RING_QUEUE)
+    using q_type = details::byte_ring_blocking_queue;
+#elif defined(SPDLOG_PER_THREAD_QUEUE)
+    using q_type = details::per_thread_blocking_queue<item_type>;
+#elif defined(SPDLOG_LOCKFREE_QUEUE)
+    using q_type = details::lockfree_blocking_queue<item_type>;
+#else
+    using q_type = details::mpmc_blocking_queue<item_type>;
 #endif
 
-    // construct from log_msg with given type
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type, details::log_msg &m)
-        : msg_type(the_type)
-        , level(m.level)
-        , time(m.time)
-        , thread_id(m.thread_id)
-        , msg_id(m.msg_id)
-        , source(m.source)
-        , worker_ptr(std::move(worker))
+    // batch_size: max number of messages each worker drains from the queue at once.
+    // flushes triggered by flush_on(..) are done once per batch.
+    // sharding: whether all threads share a single queue, or each has its own queue of
+    // q_max_items (see async_queue_sharding).
+    // high_lane: high priority lane of each queue (see async_priority_lane).
+    // options: placement and hooks of the threads (see thread_options), including the ones
+    // added later (see set_thread_count(..)).
+    // memory: how the queues' memory is allocated (see async_queue_memory).
+    thread_pool(size_t q_max_items, size_t threads_n, size_t batch_size, async_queue_sharding sharding, async_priority_lane high_lane,
+        const thread_options &options, const async_queue_memory &memory)
+        : batch_size_(batch_size)
+        , high_lane_(high_lane)
+        , options_(options)
+        , stopped_(stopped_promise_.get_future().share())
     {
-        fmt_helper::append_string_view(m.payload, raw);
+        // std::cout << "thread_pool()  q_size_bytes: " << q_size_bytes <<
+        // "\tthreads_n: " << threads_n << std::endl;
+        if (threads_n == 0 || threads_n > 1000)
+        {
+            throw spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
+                            "range is 1-1000)");
+        }
+        if (batch_size == 0)
+        {
+            throw spdlog_ex("spdlog::thread_pool(): invalid batch_size param (must be at least 1)");
+        }
+        size_t queues_n = sharding == async_queue_sharding::per_thread ? threads_n : 1;
+        staged_queues_.reset(new std::atomic<bool>[queues_n]);
+        for (size_t i = 0; i < queues_n; i++)
+        {
+            staged_queues_[i].store(false, std::memory_order_relaxed);
+            queues_.emplace_back(new q_type(q_max_items, memory));
+            counters_.emplace_back(new queue_counters());
+            spills_.emplace_back(new spill_file());
+            if (high_lane.q_max_items > 0)
+            {
+                high_queues_.emplace_back(new q_type(high_lane.q_max_items, memory));
+                high_counters_.emplace_back(new queue_counters());
+                doorbells_.emplace_back(new doorbell());
+            }
+        }
+        try
+        {
+            for (size_t i = 0; i < threads_n; i++)
+            {
+                add_thread_(i % queues_n);
+            }
+        }
+        catch (...)
+        {
+            stop_threads_();
+            threads_stopped_ = true;
+            stopped_promise_.set_value();
+            throw;
+        }
     }
 
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type)
-        : msg_type(the_type)
-        , level(level::off)
-        , time()
-        , thread_id(0)
-        , msg_id(0)
-        , source()
-        , worker_ptr(std::move(worker))
+    thread_pool(size_t q_max_items, size_t threads_n, size_t batch_size, async_queue_sharding sharding, async_priority_lane high_lane,
+        const thread_options &options)
+        : thread_pool(q_max_items, threads_n, batch_size, sharding, high_lane, options, async_queue_memory())
     {
     }
 
-    explicit async_msg(async_msg_type the_type)
-        : async_msg(nullptr, the_type)
+    thread_pool(size_t q_max_items, size_t threads_n, size_t batch_size, async_queue_sharding sharding, async_priority_lane high_lane)
+        : thread_pool(q_max_items, threads_n, batch_size, sharding, high_lane, thread_options())
     {
     }
 
-    // copy into log_msg
-    log_msg to_log_msg()
+    thread_pool(size_t q_max_items, size_t threads_n, size_t batch_size, async_queue_sharding sharding)
+        : thread_pool(q_max_items, threads_n, batch_size, sharding, async_priority_lane())
     {
-        log_msg msg(&worker_ptr->name(), level, string_view_t(raw.data(), raw.size()));
-        msg.time = time;
-        msg.thread_id = thread_id;
-        msg.msg_id = msg_id;
-        msg.source = source;
-        msg.color_range_start = 0;
-        msg.color_range_end = 0;
-        return msg;
     }
-};
 
-class thread_pool
-{
-public:
-    using item_type = async_msg;
-    using q_type = details::mpmc_blocking_queue<item_type>;
+    thread_pool(size_t q_max_items, size_t threads_n, const thread_options &options)
+        : thread_pool(q_max_items, threads_n, 1, async_queue_sharding::shared, async_priority_lane(), options)
+    {
+    }
+
+    thread_pool(size_t q_max_items, size_t threads_n, const async_queue_memory &memory)
+        : thread_pool(q_max_items, threads_n, 1, async_queue_sharding::shared, async_priority_lane(), thread_options(), memory)
+    {
+    }
+
+    thread_pool(size_t q_max_items, size_t threads_n, size_t batch_size)
+        : thread_pool(q_max_items, threads_n, batch_size, async_queue_sharding::shared)
+    {
+    }
 
     thread_pool(size_t q_max_items, size_t threads_n)
-        : q_(q_max_items)
+        : thread_pool(q_max_items, threads_n, 1)
     {
-        // std::cout << "thread_pool()  q_size_bytes: " << q_size_bytes <<
-        // "\tthreads_n: " << threads_n << std::endl;
-        if (threads_n == 0 || threads_n > 1000)
+    }
+
+    // message all threads to terminate gracefully join them
+    ~thread_pool()
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        if (threads_stopped_)
         {
-            throw spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
-                            "range is 1-1000)");
+            return;
+        }
+        try
+        {
+            // producers that are still posting (through a pool_guard) go first
+            pool_slots::wait_unused(this);
+            publish_stages_(true);
+            stop_threads_();
         }
-        for (size_t i = 0; i < threads_n; i++)
+        catch (...)
         {
-            threads_.emplace_back(&thread_pool::worker_loop_, this);
         }
+        threads_stopped_ = true;
+        stopped_promise_.set_value();
     }
 
-    // message all threads to terminate gracefully join them
-    ~thread_pool()
+    // stop accepting new messages, process the queued ones until the timeout expires and
+    // discard the rest, then stop the threads (the pool can't be used anymore).
+    // return the number of discarded log messages - queued ones that were not processed
+    // in time, and the ones posted since drain(..) was called.
+    // a sink that never returns can't be interrupted, and still holds up its thread.
+    size_t drain(std::chrono::milliseconds timeout)
     {
-        try
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        if (!threads_stopped_)
+        {
+            drain_deadline_.store(deadline_from_now_(timeout), std::memory_order_relaxed);
+            accepting_.store(false, std::memory_order_relaxed);
+            // producers that didn't see accepting_ change are done posting after this
+            pool_slots::wait_unused(this);
+            publish_stages_(true);
+            stop_threads_();
+            discard_queued_();
+            threads_stopped_ = true;
+            stopped_promise_.set_value();
+        }
+        return discarded_.load(std::memory_order_relaxed);
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(thread_pool &&) = delete;
+
+    // deferred_fn: if set, msg.payload holds the captured arguments of the log call and
+    // the worker formats them with it.
+    void post_log(async_logger_ptr worker_ptr, details::log_msg &msg, async_overflow_policy overflow_policy,
+        deferred_format_fn deferred_fn = nullptr)
+    {
+        if (!accepting_.load(std::memory_order_relaxed))
+        {
+            discarded_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto index = queue_index_(worker_ptr);
+        auto *q = queues_[index].get();
+        auto *counters = counters_[index].get();
+        bool high_lane = !high_queues_.empty() && msg.level >= high_lane_.min_level;
+        if (high_lane)
+        {
+            q = high_queues_[index].get();
+            counters = high_counters_[index].get();
+            overflow_policy = high_lane_.overflow_policy;
+        }
+        auto *quota = worker_ptr->quota_.load(std::memory_order_relaxed);
+        if (quota != nullptr && !acquire_quota_(*quota, overflow_policy, worker_ptr->block_timeout()))
+        {
+            return;
+        }
+        if (!high_lane && overflow_policy == async_overflow_policy::block && batch_max_items_.load(std::memory_order_relaxed) > 1)
         {
-            for (size_t i = 0; i < threads_.size(); i++)
+            if (auto *stage = this_thread_stage_())
             {
-                post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+                stage_(*stage, index, async_msg(worker_ptr, async_msg_type::log, msg, deferred_fn, quota));
+                return;
             }
-
-            for (auto &t : threads_)
+        }
+        bool posted = true;
+#if defined(SPDLOG_BYTE_RING_QUEUE)
+        if (!high_lane && spills_[index]->enabled())
+        {
+            posted = post_normal_(index, async_msg(worker_ptr, async_msg_type::log, msg, deferred_fn, quota), overflow_policy,
+                worker_ptr->block_timeout());
+        }
+        else
+        {
+            // serialize the message straight into the ring
+            switch (overflow_policy)
             {
-                t.join();
+            case async_overflow_policy::block:
+            case async_overflow_policy::spill:
+                q->enqueue(worker_ptr, async_msg_type::log, msg, deferred_fn, quota, wait_hook{counters});
+                break;
+            case async_overflow_policy::overrun_oldest:
+                q->enqueue_nowait(worker_ptr, async_msg_type::log, msg, deferred_fn, quota, overrun_hook{counters});
+                break;
+            case async_overflow_policy::block_with_timeout:
+                posted = q->enqueue_for(
+                    worker_ptr, async_msg_type::log, msg, deferred_fn, quota, worker_ptr->block_timeout(), wait_hook{counters});
+                break;
+            case async_overflow_policy::discard_new:
+                posted = q->try_enqueue(worker_ptr, async_msg_type::log, msg, deferred_fn, quota);
+                break;
             }
+            posted = counters->count_posted(posted, overflow_policy);
         }
-        catch (...)
+#else
+        async_msg async_m(worker_ptr, async_msg_type::log, msg, deferred_fn, quota);
+        if (high_lane)
+        {
+            posted = post_async_msg_(*q, *counters, std::move(async_m), overflow_policy, worker_ptr->block_timeout());
+        }
+        else
+        {
+            posted = post_normal_(index, std::move(async_m), overflow_policy, worker_ptr->block_timeout());
+        }
+#endif
+        if (posted)
         {
+            ring_(index);
+        }
+        else if (quota != nullptr)
+        {
+            quota->release(1);
         }
     }
 
-    thread_pool(const thread_pool &) = delete;
-    thread_pool &operator=(thread_pool &&) = delete;
+    // flushed: if set, it is set once the logger's sinks were flushed
+    void post_flush(async_logger_ptr worker_ptr, async_overflow_policy overflow_policy,
+        std::unique_ptr<std::promise<void>> flushed = nullptr)
+    {
+        if (!accepting_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        if (!is_pool_thread_())
+        {
+            // the flush must come after the messages staged before it
+            publish_stages_(false);
+        }
+        auto index = queue_index_(worker_ptr);
+        async_msg async_m(worker_ptr, async_msg_type::flush);
+        async_m.flushed = std::move(flushed);
+        // a dropped flush breaks its promise
+        if (post_normal_(index, std::move(async_m), overflow_policy, worker_ptr->block_timeout()))
+        {
+            ring_(index);
+        }
+    }
+
+    // block until all the messages posted so far were processed (or dropped), so the loggers
+    // they point to may go away. called by the async_logger destructor.
+    // returns right away if called from one of the pool's threads (which can't wait for itself).
+    // returns false without waiting if the pool is being drained - wait for stopped() instead
+    // (once the caller doesn't hold up drain(..) anymore).
+    bool wait_processed()
+    {
+        if (is_pool_thread_())
+        {
+            return true;
+        }
+        if (!accepting_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        publish_stages_(false);
+
+        // each worker gets a barrier message, and waits at it until all got theirs -
+        // so every worker is done with whatever it dequeued before.
+        // one round at a time - workers of two rounds would wait for each other.
+        std::lock_guard<std::mutex> round_lock(barrier_round_mutex_);
+        size_t generation;
+        {
+            std::lock_guard<std::mutex> lock(barrier_mutex_);
+            generation = barrier_generation_;
+        }
+        for (size_t i = 0; i < threads_n_.load(std::memory_order_relaxed); i++)
+        {
+            enqueue_(i % queues_.size(), async_msg(async_msg_type::barrier));
+        }
+        std::unique_lock<std::mutex> lock(barrier_mutex_);
+        barrier_cv_.wait(lock, [this, generation] { return this->barrier_generation_ != generation; });
+        return true;
+    }
 
-    void post_log(async_logger_ptr &&worker_ptr, details::log_msg &msg, async_overflow_policy overflow_policy)
+    // takes effect the next time each thread finds its queue empty
+    void set_wait_strategy(async_wait_strategy wait_strategy)
     {
-        async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
-        post_async_msg_(std::move(async_m), overflow_policy);
+        wait_strategy_.store(wait_strategy, std::memory_order_relaxed);
     }
 
-    void post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy)
+    async_wait_strategy wait_strategy() const
     {
-        post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush), overflow_policy);
+        return wait_strategy_.load(std::memory_order_relaxed);
     }
 
-    size_t overrun_counter()
+    // enable (or disable) producer side batching (see async_producer_batching).
+    // messages staged already are put in the queue as usual when it is disabled.
+    void set_producer_batching(const async_producer_batching &batching)
     {
-        return q_.overrun_counter();
+        batch_publish_level_.store(batching.publish_level, std::memory_order_relaxed);
+        batch_max_delay_.store(std::max(batching.max_delay.count(), std::chrono::milliseconds::rep(1)), std::memory_order_relaxed);
+        batch_max_items_.store(batching.max_items, std::memory_order_relaxed);
     }
 
-private:
-    q_type q_;
+    async_producer_batching producer_batching() const
+    {
+        async_producer_batching batching;
+        batching.max_items = batch_max_items_.load(std::memory_order_relaxed);
+        batching.max_delay = std::chrono::milliseconds(batch_max_delay_.load(std::memory_order_relaxed));
+        batching.publish_level = batch_publish_level_.load(std::memory_order_relaxed);
+        return batching;
+    }
 
-    std::vector<std::thread> threads_;
+    size_t thread_count() const
+    {
+        return threads_n_.load(std::memory_order_relaxed);
+    }
 
-    void post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy)
+    // add or remove threads (valid range is 1-1000). removed threads finish what they
+    // dequeued first. throws spdlog_ex if the pool is sharded - each of its threads owns
+    // a queue, which keeps the messages of each logger in order.
+    void set_thread_count(size_t threads_n)
     {
-        if (overflow_policy == async_overflow_policy::block)
+        if (threads_n == 0 || threads_n > 1000)
         {
-            q_.enqueue(std::move(new_msg));
+            throw spdlog_ex("spdlog::thread_pool::set_thread_count(): invalid threads_n param (valid range is 1-1000)");
+        }
+        throw_if_sharded_();
+        std::lock_guard<std::mutex> stop_lock(stop_mutex_);
+        if (threads_stopped_)
+        {
+            return;
+        }
+        // not in the middle of a barrier round, whose workers were counted
+        std::lock_guard<std::mutex> round_lock(barrier_round_mutex_);
+        join_exited_();
+        while (thread_count() < threads_n)
+        {
+            add_thread_(0);
+        }
+        size_t retiring = thread_count() - threads_n;
+        for (size_t i = 0; i < retiring; i++)
+        {
+            enqueue_(0, async_msg(async_msg_type::terminate));
         }
-        else
         {
-            q_.enqueue_nowait(std::move(new_msg));
+            std::unique_lock<std::mutex> lock(workers_mutex_);
+            workers_cv_.wait(lock, [this, threads_n] { return this->threads_.size() == threads_n; });
         }
+        join_exited_();
     }
 
-    void worker_loop_()
+    // let the threads add and remove threads within the given bounds (see async_autoscale).
+    // throws spdlog_ex if the pool is sharded (see set_thread_count(..)) or the bounds are invalid.
+    void set_autoscale(const async_autoscale &autoscale)
     {
-        while (process_next_msg_()) {};
+        if (autoscale.max_threads > 0 &&
+            (autoscale.min_threads == 0 || autoscale.min_threads > autoscale.max_threads || autoscale.max_threads > 1000))
+        {
+            throw spdlog_ex("spdlog::thread_pool::set_autoscale(): invalid bounds (valid range is "
+                            "1 <= min_threads <= max_threads <= 1000)");
+        }
+        throw_if_sharded_();
+        autoscale_min_.store(autoscale.min_threads, std::memory_order_relaxed);
+        autoscale_grow_depth_.store(autoscale.grow_depth, std::memory_order_relaxed);
+        autoscale_idle_.store(autoscale.idle_shrink.count(), std::memory_order_relaxed);
+        autoscale_max_.store(autoscale.max_threads, std::memory_order_relaxed);
     }
 
-    // process next message in the queue
-    // return true if this thread should still be active (while no terminate msg
-    // was received)
-    bool process_next_msg_()
+    async_autoscale autoscale() const
+    {
+        async_autoscale autoscale;
+        autoscale.min_threads = autoscale_min_.load(std::memory_order_relaxed);
+        autoscale.max_threads = autoscale_max_.load(std::memory_order_relaxed);
+        autoscale.grow_depth = autoscale_grow_depth_.load(std::memory_order_relaxed);
+        autoscale.idle_shrink = std::chrono::milliseconds(autoscale_idle_.load(std::memory_order_relaxed));
+        return autoscale;
+    }
+
+    // limit the messages of the quota group's loggers in the pool (queued or being
+    // processed) to max_in_flight, 0 for no limit (see async_logger::set_quota_group(..)).
+    void set_quota(const std::string &group, size_t max_in_flight)
     {
-        async_msg incoming_async_msg;
-        bool dequeued = q_.dequeue_for(incoming_async_msg, std::chrono::seconds(10));
-        if (!dequeued)
+        quota(group)->set_max_in_flight(max_in_flight);
+    }
+
+    // the quota group of that name, created without limit on first use. lives as long as the pool.
+    async_quota *quota(const std::string &group)
+    {
+        std::lock_guard<std::mutex> lock(quotas_mutex_);
+        auto &group_quota = quotas_[group];
+        if (!group_quota)
         {
-            return true;
+            group_quota.reset(new async_quota(0));
+        }
+        return group_quota.get();
+    }
+
+    // let the loggers of each batch take turns, up to quantum messages at a time - so a
+    // logger with many messages in a batch doesn't hold up the others until it's done.
+    // the messages of each logger, and the other messages, keep their order.
+    // 0 (the default) processes batches in order. pays off only with a batch_size > 1.
+    void set_fair_drain_quantum(size_t quantum)
+    {
+        fair_quantum_.store(quantum, std::memory_order_relaxed);
+    }
+
+    size_t fair_drain_quantum() const
+    {
+        return fair_quantum_.load(std::memory_order_relaxed);
+    }
+
+    // let the loggers with the spill overflow policy append their messages to a file while
+    // their queue is full (see spill_file.h), instead of waiting for room. the threads replay
+    // it in order once they caught up. sharded pools have a file per queue (filename.<index>).
+    // set it once, before logging to the pool. throws spdlog_ex if it was set already.
+    void set_spill_file(const filename_t &filename)
+    {
+        for (size_t i = 0; i < spills_.size(); i++)
+        {
+            if (spills_.size() == 1)
+            {
+                spills_[i]->set_filename(filename);
+                continue;
+            }
+            typename std::conditional<std::is_same<filename_t::value_type, char>::value, fmt::memory_buffer, fmt::wmemory_buffer>::type w;
+            fmt::format_to(w, SPDLOG_FILENAME_T("{}.{}"), filename, i);
+            spills_[i]->set_filename(fmt::to_string(w));
+        }
+    }
+
+    // ready once the pool's threads are joined (that is, when its destructor is done with the queue)
+    std::shared_future<void> stopped() const
+    {
+        return stopped_;
+    }
+
+    // messages dropped by both lanes
+    size_t overrun_counter()
+    {
+        return overrun_counter(async_lane::normal) + overrun_counter(async_lane::high);
+    }
+
+    size_t overrun_counter(async_lane lane)
+    {
+        size_t overrun_counter = 0;
+        for (auto &q : lane == async_lane::high ? high_queues_ : queues_)
+        {
+            overrun_counter += q->overrun_counter();
         }
+        return overrun_counter;
+    }
 
-        switch (incoming_async_msg.msg_type)
+    // snapshot of the queues' counters, taken without locking
+    async_pool_stats telemetry() const
+    {
+        async_pool_stats stats;
+        for (auto &counters : counters_)
         {
-        case async_msg_type::log:
+            stats.queues.push_back(counters->snapshot());
+        }
+        for (auto &counters : high_counters_)
         {
-            auto msg = incoming_async_msg.to_log_msg();
-            incoming_async_msg.worker_ptr->backend_log_(msg);
-            return true;
+            stats.high_queues.push_back(counters->snapshot());
         }
-        case async_msg_type::flush:
+        return stats;
+    }
+
+private:
+    // lock free counters of a queue (see telemetry()).
+    // dequeued is written by the consumers only, on a cache line of its own.
+    struct queue_counters
+    {
+        std::atomic<size_t> enqueued{0};
+        std::atomic<size_t> overruns{0};
+        std::atomic<size_t> timeouts{0};
+        std::atomic<size_t> discarded_new{0};
+        std::atomic<size_t> spilled{0};
+        std::atomic<size_t> high_water_mark{0};
+        std::atomic<size_t> blocked_waits[async_queue_stats::wait_buckets];
+        std::atomic<uint64_t> blocked_ns{0};
+        padded_atomic_size dequeued;
+        char pad_after[cache_line_size];
+
+        queue_counters()
         {
-            incoming_async_msg.worker_ptr->backend_flush_();
-            return true;
+            for (auto &waits : blocked_waits)
+            {
+                waits.store(0, std::memory_order_relaxed);
+            }
         }
 
-        case async_msg_type::terminate:
+        // count the message put in the queue, or dropped by the policy. return posted
+        bool count_posted(bool posted, async_overflow_policy overflow_policy)
         {
-            return false;
+            if (posted)
+            {
+                count_enqueued(1);
+            }
+            else if (overflow_policy == async_overflow_policy::block_with_timeout)
+            {
+                timeouts.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                discarded_new.fetch_add(1, std::memory_order_relaxed);
+            }
+            return posted;
         }
+
+        void count_enqueued(size_t n)
+        {
+            size_t in = enqueued.fetch_add(n, std::memory_order_relaxed) + n;
+            size_t depth = depth_(in);
+            size_t high_water = high_water_mark.load(std::memory_order_relaxed);
+            while (depth > high_water && !high_water_mark.compare_exchange_weak(high_water, depth, std::memory_order_relaxed)) {}
+        }
+
+        void count_spilled()
+        {
+            spilled.fetch_add(1, std::memory_order_relaxed);
+            count_enqueued(1);
+        }
+
+        void count_dequeued(size_t n)
+        {
+            if (n > 0)
+            {
+                dequeued.value.fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+
+        void count_wait(queue_wait_clock::duration waited)
+        {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+            size_t bucket = 0;
+            for (; us > 0 && bucket + 1 < async_queue_stats::wait_buckets; us >>= 1)
+            {
+                bucket++;
+            }
+            blocked_waits[bucket].fetch_add(1, std::memory_order_relaxed);
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count();
+            blocked_ns.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+        }
+
+        async_queue_stats snapshot() const
+        {
+            async_queue_stats stats;
+            stats.enqueued = enqueued.load(std::memory_order_relaxed);
+            stats.dequeued = dequeued.value.load(std::memory_order_relaxed);
+            stats.overruns = overruns.load(std::memory_order_relaxed);
+            stats.timeouts = timeouts.load(std::memory_order_relaxed);
+            stats.discarded_new = discarded_new.load(std::memory_order_relaxed);
+            stats.spilled = spilled.load(std::memory_order_relaxed);
+            stats.depth = depth_(stats.enqueued);
+            stats.high_water_mark = high_water_mark.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < async_queue_stats::wait_buckets; i++)
+            {
+                stats.blocked_waits[i] = blocked_waits[i].load(std::memory_order_relaxed);
+            }
+            stats.blocked_time = std::chrono::nanoseconds(blocked_ns.load(std::memory_order_relaxed));
+            return stats;
+        }
+
+        size_t depth() const
+        {
+            return depth_(enqueued.load(std::memory_order_relaxed));
+        }
+
+        // the consumers may count a message before its producer did - so clamp at 0
+        size_t depth_(size_t in) const
+        {
+            size_t out = dequeued.value.load(std::memory_order_relaxed) + overruns.load(std::memory_order_relaxed);
+            return in > out ? in - out : 0;
+        }
+    };
+
+    // queue hooks (see no_queue_hook) that update the counters
+    struct wait_hook
+    {
+        queue_counters *counters;
+        void operator()(queue_wait_clock::duration waited) const
+        {
+            counters->count_wait(waited);
+        }
+    };
+
+    struct overrun_hook
+    {
+        queue_counters *counters;
+        void operator()(const async_msg &dropped) const
+        {
+            (*this)(dropped.worker_ptr, dropped.msg_type, dropped.quota);
+        }
+        // the byte ring passes the fields instead of the message
+        void operator()(const async_logger_ptr &worker_ptr, async_msg_type msg_type, async_quota *quota) const
+        {
+            counters->overruns.fetch_add(1, std::memory_order_relaxed);
+            if (msg_type == async_msg_type::log && worker_ptr)
+            {
+                worker_ptr->overruns_.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (quota != nullptr)
+            {
+                quota->release(1);
+            }
+        }
+    };
+
+    // with a high priority lane, workers don't park on their queues but here - so a
+    // message in either lane wakes them up. same protocol as lockfree_blocking_queue:
+    // the fences make either the parked worker see the new message, or the producer see
+    // the worker parked.
+    struct doorbell
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<size_t> parked{0};
+
+        void ring()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (parked.load(std::memory_order_relaxed) > 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                }
+                cv.notify_all();
+            }
+        }
+    };
+
+    // a single queue shared by all threads, or one queue per thread.
+    // the high lane queues and their doorbells (same index) exist only if the lane is enabled.
+    std::vector<std::unique_ptr<q_type>> queues_;
+    std::vector<std::unique_ptr<q_type>> high_queues_;
+    std::vector<std::unique_ptr<doorbell>> doorbells_;
+    std::vector<std::unique_ptr<queue_counters>> counters_;
+    std::vector<std::unique_ptr<queue_counters>> high_counters_;
+    std::vector<std::unique_ptr<spill_file>> spills_; // one per queue of the normal lane
+    const size_t batch_size_;
+    const async_priority_lane high_lane_;
+    const thread_options options_;
+    std::atomic<async_wait_strategy> wait_strategy_{async_wait_strategy::blocking};
+
+    // messages staged by a thread for the pool (see async_producer_batching).
+    // pool is called to publish them when the thread exits, unless closed by the pool.
+    struct producer_stage
+    {
+        std::mutex mutex;
+        std::vector<async_msg> msgs;
+        size_t q_index = 0;
+        queue_wait_clock::time_point staged_at;
+        thread_pool *pool = nullptr;
+        bool closed = false;
+    };
+
+    // the stages of all threads that staged messages. has_stages_ is set with the first one.
+    const size_t id_ = next_pool_id_();
+    std::mutex stages_mutex_;
+    std::vector<std::shared_ptr<producer_stage>> stages_;
+    std::atomic<bool> has_stages_{false};
+    std::unique_ptr<std::atomic<bool>[]> staged_queues_;
+    std::atomic<size_t> batch_max_items_{0};
+    std::atomic<std::chrono::milliseconds::rep> batch_max_delay_{1};
+    std::atomic<level::level_enum> batch_publish_level_{level::err};
+
+    std::promise<void> stopped_promise_;
+    std::shared_future<void> stopped_;
+
+    std::mutex barrier_round_mutex_;
+    std::mutex barrier_mutex_;
+    std::condition_variable barrier_cv_;
+    size_t barrier_arrived_ = 0;
+    size_t barrier_generation_ = 0;
+
+    // the threads and their index (see thread_options). threads that retired on their own
+    // wait in exited_ to be joined. threads_n_ is the size of threads_, which changes
+    // only under barrier_round_mutex_ (after construction).
+    struct worker_thread
+    {
+        std::thread thread;
+        size_t index;
+    };
+    std::mutex workers_mutex_;
+    std::condition_variable workers_cv_;
+    std::vector<worker_thread> threads_;
+    std::vector<worker_thread> exited_;
+    std::atomic<size_t> threads_n_{0};
+    bool stopping_ = false;
+
+    std::atomic<size_t> autoscale_min_{1};
+    std::atomic<size_t> autoscale_max_{0};
+    std::atomic<size_t> autoscale_grow_depth_{1024};
+    std::atomic<std::chrono::milliseconds::rep> autoscale_idle_{10000};
+
+    std::mutex quotas_mutex_;
+    std::map<std::string, std::unique_ptr<async_quota>> quotas_;
+    std::atomic<size_t> fair_quantum_{0};
+
+    // drain(..) state. drain_deadline_ is a steady_clock time (max if not draining).
+    std::mutex stop_mutex_;
+    bool threads_stopped_ = false;
+    std::atomic<bool> accepting_{true};
+    std::atomic<std::chrono::steady_clock::rep> drain_deadline_{std::chrono::steady_clock::duration::max().count()};
+    std::atomic<size_t> discarded_{0};
+
+    // post a terminate message to each thread and join them.
+    // threads_ doesn't change once stopping_ is set.
+    void stop_threads_()
+    {
+        {
+            std::lock_guard<std::mutex> lock(workers_mutex_);
+            stopping_ = true;
+        }
+        for (size_t i = 0; i < threads_.size(); i++)
+        {
+            enqueue_(i % queues_.size(), async_msg(async_msg_type::terminate));
+        }
+        for (auto &t : threads_)
+        {
+            t.thread.join();
+        }
+        join_exited_();
+    }
+
+    // start a thread with the lowest free index, working on the queue at q_index
+    void add_thread_(size_t q_index)
+    {
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        size_t index = 0;
+        while (std::any_of(threads_.begin(), threads_.end(), [index](const worker_thread &t) { return t.index == index; }))
+        {
+            index++;
+        }
+        threads_.push_back(worker_thread{start_thread(options_, index, true, [this, q_index] { this->worker_loop_(q_index); }), index});
+        threads_n_.store(threads_.size(), std::memory_order_relaxed);
+    }
+
+    // move the calling thread from threads_ to exited_ (unless the pool is stopping, and
+    // joins threads_). under workers_mutex_
+    void retire_this_thread_()
+    {
+        auto this_id = std::this_thread::get_id();
+        auto it =
+            std::find_if(threads_.begin(), threads_.end(), [this_id](const worker_thread &t) { return t.thread.get_id() == this_id; });
+        if (stopping_ || it == threads_.end())
+        {
+            return;
+        }
+        exited_.push_back(std::move(*it));
+        threads_.erase(it);
+        threads_n_.store(threads_.size(), std::memory_order_relaxed);
+        workers_cv_.notify_all();
+    }
+
+    void join_exited_()
+    {
+        std::vector<worker_thread> exited;
+        {
+            std::lock_guard<std::mutex> lock(workers_mutex_);
+            exited.swap(exited_);
+        }
+        for (auto &t : exited)
+        {
+            t.thread.join();
+        }
+    }
+
+    void throw_if_sharded_() const
+    {
+        if (queues_.size() > 1)
+        {
+            throw spdlog_ex("spdlog::thread_pool: the thread count of a sharded pool is fixed");
+        }
+    }
+
+    static std::chrono::steady_clock::rep deadline_from_now_(std::chrono::milliseconds timeout)
+    {
+        using std::chrono::milliseconds;
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        auto max = std::chrono::steady_clock::duration::max();
+        if (timeout >= std::chrono::duration_cast<milliseconds>(max - now))
+        {
+            return max.count();
+        }
+        return (now + timeout).count();
+    }
+
+    bool past_drain_deadline_() const
+    {
+        auto deadline = drain_deadline_.load(std::memory_order_relaxed);
+        return deadline != std::chrono::steady_clock::duration::max().count() &&
+               std::chrono::steady_clock::now().time_since_epoch().count() >= deadline;
+    }
+
+    // count the log messages left in the queues once the threads are stopped
+    void discard_queued_()
+    {
+        std::vector<async_msg> batch(batch_size_);
+        auto discard_from = [this, &batch](q_type &q, queue_counters &counters) {
+            size_t dequeued;
+            while ((dequeued = q.dequeue_bulk_for(batch.data(), batch.size(), std::chrono::milliseconds::zero())) > 0)
+            {
+                count_discarded_(batch.data(), dequeued, counters);
+            }
+        };
+        for (size_t i = 0; i < queues_.size(); i++)
+        {
+            discard_from(*queues_[i], *counters_[i]);
+            size_t read;
+            while ((read = spills_[i]->read(batch.data(), batch.size())) > 0)
+            {
+                count_discarded_(batch.data(), read, *counters_[i]);
+            }
+        }
+        for (size_t i = 0; i < high_queues_.size(); i++)
+        {
+            discard_from(*high_queues_[i], *high_counters_[i]);
+        }
+    }
+
+    void count_discarded_(async_msg *msgs, size_t n, queue_counters &counters)
+    {
+        counters.count_dequeued(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (msgs[i].msg_type == async_msg_type::log)
+            {
+                discarded_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        release_quotas_(msgs, n);
+    }
+
+    // index of the queue of the thread the logger is pinned to (0 if not sharded)
+    size_t queue_index_(async_logger_ptr worker_ptr) const
+    {
+        return worker_ptr->shard() % queues_.size();
+    }
+
+    // wake up the workers of the queue at index if they wait for both lanes
+    void ring_(size_t index)
+    {
+        if (!doorbells_.empty())
+        {
+            doorbells_[index]->ring();
+        }
+    }
+
+    // post a control message to the normal lane of the queue at index
+    void enqueue_(size_t index, async_msg &&new_msg)
+    {
+        post_normal_(index, std::move(new_msg), async_overflow_policy::block);
+        ring_(index);
+    }
+
+    // post to the normal lane of the queue at index - through its spill file while it is
+    // active, and if the queue is full for the spill policy.
+    // return false if the message was dropped (see post_async_msg_(..)).
+    bool post_normal_(size_t index, async_msg &&new_msg, async_overflow_policy overflow_policy,
+        std::chrono::milliseconds block_timeout = std::chrono::milliseconds::zero())
+    {
+        auto &q = *queues_[index];
+        auto &counters = *counters_[index];
+        auto &spill = *spills_[index];
+        bool spill_if_full = overflow_policy == async_overflow_policy::spill && spill.enabled();
+        if (!spill.active())
+        {
+            if (!spill_if_full)
+            {
+                return post_async_msg_(q, counters, std::move(new_msg), overflow_policy, block_timeout);
+            }
+            if (q.try_enqueue(std::move(new_msg)))
+            {
+                return counters.count_posted(true, overflow_policy);
+            }
+        }
+
+        spill_file::outcome outcome;
+        try
+        {
+            outcome = spill.spill(new_msg, spill_if_full, [&q](async_msg &msg) { return q.try_enqueue(std::move(msg)); });
+        }
+        catch (...)
+        {
+            release_quotas_(&new_msg, 1);
+            throw;
+        }
+        switch (outcome)
+        {
+        case spill_file::outcome::appended:
+            counters.count_spilled();
+            return true;
+        case spill_file::outcome::posted:
+            return counters.count_posted(true, overflow_policy);
+        default:
+            return post_async_msg_(q, counters, std::move(new_msg), overflow_policy, block_timeout);
+        }
+    }
+
+    bool is_pool_thread_()
+    {
+        auto this_id = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        for (auto &t : threads_)
+        {
+            if (t.thread.get_id() == this_id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static size_t next_pool_id_()
+    {
+        static std::atomic<size_t> last_id{0};
+        return last_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // stage the message, and publish the stage if it is full or the message is important enough.
+    // the first message staged for a queue is published right away - to wake up its threads,
+    // which may be parked for longer than max_delay.
+    void stage_(producer_stage &stage, size_t index, async_msg &&new_msg)
+    {
+        std::lock_guard<std::mutex> lock(stage.mutex);
+        if (!stage.msgs.empty() && stage.q_index != index)
+        {
+            // the logger moved to another shard
+            publish_(stage);
+        }
+        if (stage.msgs.empty())
+        {
+            stage.q_index = index;
+            stage.staged_at = queue_wait_clock::now();
+        }
+        auto level = new_msg.level;
+        stage.msgs.push_back(std::move(new_msg));
+        if (stage.msgs.size() >= batch_max_items_.load(std::memory_order_relaxed) ||
+            level >= batch_publish_level_.load(std::memory_order_relaxed) || !staged_queues_[index].exchange(true))
+        {
+            publish_(stage);
+        }
+    }
+
+    // put the staged messages in the queue, blocking while it is full. under the stage's lock
+    void publish_(producer_stage &stage)
+    {
+        auto &msgs = stage.msgs;
+        if (spills_[stage.q_index]->active())
+        {
+            // after the messages spilled before them
+            for (size_t i = 0; i < msgs.size(); i++)
+            {
+                try
+                {
+                    post_normal_(stage.q_index, std::move(msgs[i]), async_overflow_policy::block);
+                }
+                catch (...)
+                {
+                    release_quotas_(msgs.data() + i + 1, msgs.size() - i - 1);
+                    msgs.clear();
+                    throw;
+                }
+            }
+            msgs.clear();
+            ring_(stage.q_index);
+            return;
+        }
+        auto &counters = *counters_[stage.q_index];
+        try
+        {
+            queues_[stage.q_index]->enqueue_bulk(stage.msgs.data(), stage.msgs.size(), wait_hook{&counters});
+        }
+        catch (...)
+        {
+            release_quotas_(stage.msgs.data(), stage.msgs.size());
+            stage.msgs.clear();
+            throw;
+        }
+        counters.count_enqueued(stage.msgs.size());
+        stage.msgs.clear();
+        ring_(stage.q_index);
+    }
+
+    // publish the messages staged by all threads. close: the threads can't publish anymore
+    // (the pool is about to stop).
+    void publish_stages_(bool close)
+    {
+        if (!has_stages_.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        std::vector<std::shared_ptr<producer_stage>> stages;
+        {
+            std::lock_guard<std::mutex> lock(stages_mutex_);
+            stages = stages_;
+        }
+        for (auto &stage : stages)
+        {
+            std::lock_guard<std::mutex> lock(stage->mutex);
+            if (!stage->msgs.empty())
+            {
+                publish_(*stage);
+            }
+            stage->closed = stage->closed || close;
+        }
+    }
+
+    // called by the workers: publish the messages staged for the worker's queue for longer
+    // than max_delay, at most once per max_delay. never blocks - stages in use by their
+    // thread are skipped, and what doesn't fit in the queue stays staged.
+    void publish_late_stages_(size_t q_index, queue_wait_clock::time_point &last_publish)
+    {
+        if (!has_stages_.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        auto now = queue_wait_clock::now();
+        auto max_delay = std::chrono::milliseconds(batch_max_delay_.load(std::memory_order_relaxed));
+        if (now - last_publish < max_delay)
+        {
+            return;
+        }
+        last_publish = now;
+
+        if (spills_[q_index]->active())
+        {
+            // the stages are published in order by their threads
+            return;
+        }
+        auto &q = *queues_[q_index];
+        std::lock_guard<std::mutex> lock(stages_mutex_);
+        for (auto &stage : stages_)
+        {
+            std::unique_lock<std::mutex> stage_lock(stage->mutex, std::try_to_lock);
+            if (!stage_lock.owns_lock() || stage->msgs.empty() || stage->q_index != q_index || now - stage->staged_at < max_delay)
+            {
+                continue;
+            }
+            auto &msgs = stage->msgs;
+            size_t published = 0;
+            while (published < msgs.size() && q.try_enqueue(std::move(msgs[published])))
+            {
+                published++;
+            }
+            counters_[q_index]->count_enqueued(published);
+            msgs.erase(msgs.begin(), msgs.begin() + static_cast<std::ptrdiff_t>(published));
+        }
+    }
+
+#if !defined(SPDLOG_NO_TLS)
+    struct tls_stage
+    {
+        size_t pool_id;
+        std::shared_ptr<producer_stage> stage;
+    };
+
+    // last stage used by the thread (trivially destructible, so it is still usable
+    // after the thread's other thread local objects were destroyed at exit).
+    struct stage_cache
+    {
+        size_t pool_id = 0;
+        producer_stage *stage = nullptr;
+        bool exiting = false;
+    };
+
+    // stages owned by the thread - one per pool it logged to. published when it exits.
+    struct thread_stages
+    {
+        std::vector<tls_stage> entries;
+        ~thread_stages()
+        {
+            auto &cache = stage_cache_();
+            cache.pool_id = 0;
+            cache.stage = nullptr;
+            cache.exiting = true;
+            for (auto &entry : entries)
+            {
+                auto &stage = *entry.stage;
+                std::lock_guard<std::mutex> lock(stage.mutex);
+                if (!stage.closed && !stage.msgs.empty())
+                {
+                    try
+                    {
+                        stage.pool->publish_(stage);
+                    }
+                    catch (...)
+                    {
+                    }
+                }
+            }
+        }
+    };
+
+    static stage_cache &stage_cache_()
+    {
+        static thread_local stage_cache cache;
+        return cache;
+    }
+#endif
+
+    // return the calling thread's stage, creating and registering it on first use -
+    // or nullptr if the thread is exiting (or there is no thread local storage).
+    producer_stage *this_thread_stage_()
+    {
+#if defined(SPDLOG_NO_TLS)
+        return nullptr;
+#else
+        auto &cache = stage_cache_();
+        if (cache.pool_id == id_)
+        {
+            return cache.stage;
+        }
+        if (cache.exiting)
+        {
+            return nullptr;
+        }
+
+        static thread_local thread_stages stages;
+        producer_stage *found = nullptr;
+        for (auto &entry : stages.entries)
+        {
+            if (entry.pool_id == id_)
+            {
+                found = entry.stage.get();
+                break;
+            }
+        }
+
+        if (found == nullptr)
+        {
+            // forget stages of pools that no longer exist
+            auto &entries = stages.entries;
+            for (auto it = entries.begin(); it != entries.end();)
+            {
+                it = it->stage.use_count() == 1 ? entries.erase(it) : it + 1;
+            }
+
+            auto new_stage = std::make_shared<producer_stage>();
+            new_stage->pool = this;
+            {
+                std::lock_guard<std::mutex> lock(stages_mutex_);
+                stages_.push_back(new_stage);
+            }
+            has_stages_.store(true, std::memory_order_release);
+            found = new_stage.get();
+            entries.push_back(tls_stage{id_, std::move(new_stage)});
+        }
+
+        cache.pool_id = id_;
+        cache.stage = found;
+        return found;
+#endif
+    }
+
+    // take a slot of the quota according to the policy. return false if the message is dropped.
+    static bool acquire_quota_(async_quota &quota, async_overflow_policy overflow_policy, std::chrono::milliseconds block_timeout)
+    {
+        switch (overflow_policy)
+        {
+        case async_overflow_policy::block:
+        case async_overflow_policy::spill:
+            quota.acquire();
+            return true;
+        case async_overflow_policy::block_with_timeout:
+            return quota.acquire_for(block_timeout);
+        default:
+            return quota.try_acquire();
+        }
+    }
+
+    // give back the quota slots of the messages (a run of the same quota at once)
+    static void release_quotas_(async_msg *msgs, size_t n)
+    {
+        for (size_t i = 0; i < n;)
+        {
+            auto *quota = msgs[i].quota;
+            size_t run = 1;
+            while (i + run < n && msgs[i + run].quota == quota)
+            {
+                run++;
+            }
+            if (quota != nullptr)
+            {
+                quota->release(run);
+            }
+            i += run;
+        }
+    }
+
+    // return false if the message was dropped (block_with_timeout and discard_new)
+    static bool post_async_msg_(q_type &q, queue_counters &counters, async_msg &&new_msg, async_overflow_policy overflow_policy,
+        std::chrono::milliseconds block_timeout = std::chrono::milliseconds::zero())
+    {
+        bool posted = true;
+        switch (overflow_policy)
+        {
+        case async_overflow_policy::block:
+        case async_overflow_policy::spill: // without (or past) the spill file
+            q.enqueue(std::move(new_msg), wait_hook{&counters});
+            break;
+        case async_overflow_policy::overrun_oldest:
+            q.enqueue_nowait(std::move(new_msg), overrun_hook{&counters});
+            break;
+        case async_overflow_policy::block_with_timeout:
+            posted = q.enqueue_for(std::move(new_msg), block_timeout, wait_hook{&counters});
+            break;
+        case async_overflow_policy::discard_new:
+            posted = q.try_enqueue(std::move(new_msg));
+            break;
+        }
+        return counters.count_posted(posted, overflow_policy);
+    }
+
+    // position of a log message in the order of fair_order_(..)
+    struct fair_key
+    {
+        size_t turn;
+        size_t logger;
+        size_t index;
+        bool operator<(const fair_key &other) const
+        {
+            return turn != other.turn ? turn < other.turn : logger != other.logger ? logger < other.logger : index < other.index;
+        }
+    };
+
+    // per worker buffers, reused across batches
+    struct worker_state
+    {
+        worker_state(size_t index, q_type &queue, q_type *high_queue, doorbell *bell, size_t batch_size)
+            : q_index(index)
+            , q(queue)
+            , high_q(high_queue)
+            , high_bell(bell)
+            , batch(batch_size)
+            , high_batch(high_queue != nullptr ? batch_size : 0)
+        {
+            log_msgs.reserve(batch_size);
+        }
+        size_t q_index;
+        q_type &q;
+        q_type *high_q;
+        doorbell *high_bell;
+        std::vector<async_msg> batch;
+        std::vector<async_msg> high_batch;
+        size_t dequeued = 0;
+        size_t high_dequeued = 0;
+        std::vector<log_msg> log_msgs;
+        std::vector<async_logger_ptr> pending_flush;
+        fmt::memory_buffer format_buf;
+        bool barrier_passed = false;
+        queue_wait_clock::time_point last_publish;
+        queue_wait_clock::time_point last_active = queue_wait_clock::now();
+        // fair_order_(..) buffers
+        std::vector<async_logger_ptr> fair_loggers;
+        std::vector<size_t> fair_counts;
+        std::vector<fair_key> fair_keys;
+        std::vector<async_msg> fair_scratch;
+    };
+
+    void worker_loop_(size_t q_index)
+    {
+        bool has_high_lane = !high_queues_.empty();
+        worker_state state(q_index, *queues_[q_index], has_high_lane ? high_queues_[q_index].get() : nullptr,
+            has_high_lane ? doorbells_[q_index].get() : nullptr, batch_size_);
+        while (process_next_msg_(state)) {};
+        // retired by set_thread_count(..) - or stopped
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        retire_this_thread_();
+    }
+
+    // process the next batch of messages in the queue (up to batch_size_ messages of each lane)
+    // return true if this thread should still be active (while no terminate msg
+    // was received)
+    bool process_next_msg_(worker_state &state)
+    {
+        dequeue_batch_(state);
+        counters_[state.q_index]->count_dequeued(state.dequeued);
+        // drain the high lane until it is empty - so it has none of the high lane messages
+        // logged before the normal lane messages at hand (barriers and terminate included).
+        while (state.high_dequeued > 0)
+        {
+            high_counters_[state.q_index]->count_dequeued(state.high_dequeued);
+            fair_order_(state, state.high_batch.data(), state.high_dequeued);
+            process_batch_(state, state.high_batch.data(), state.high_dequeued);
+            state.high_dequeued =
+                state.high_q->dequeue_bulk_for(state.high_batch.data(), state.high_batch.size(), std::chrono::milliseconds::zero());
+        }
+        fair_order_(state, state.batch.data(), state.dequeued);
+        bool active = process_batch_(state, state.batch.data(), state.dequeued);
+
+        flush_pending_(state);
+        state.barrier_passed = false;
+        publish_late_stages_(state.q_index, state.last_publish);
+        return active && autoscale_(state);
+    }
+
+    // called by the workers after each batch if autoscaling: add a thread if the queue is
+    // deep enough, or return false if the calling thread should retire.
+    // skipped while the pool is being resized, stopped, or waited for (the workers
+    // of a barrier round are counted).
+    bool autoscale_(worker_state &state)
+    {
+        auto max_threads = autoscale_max_.load(std::memory_order_relaxed);
+        if (max_threads == 0)
+        {
+            return true;
+        }
+        auto now = queue_wait_clock::now();
+        bool idle = state.dequeued + state.high_dequeued == 0;
+        if (!idle)
+        {
+            state.last_active = now;
+        }
+        size_t threads_n = thread_count();
+        bool grow = !idle && threads_n < max_threads && counters_[0]->depth() >= autoscale_grow_depth_.load(std::memory_order_relaxed);
+        bool shrink = idle && threads_n > autoscale_min_.load(std::memory_order_relaxed) &&
+                      now - state.last_active >= std::chrono::milliseconds(autoscale_idle_.load(std::memory_order_relaxed));
+        if (!grow && !shrink)
+        {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> stop_lock(stop_mutex_, std::try_to_lock);
+        if (!stop_lock.owns_lock() || threads_stopped_)
+        {
+            return true;
+        }
+        std::unique_lock<std::mutex> round_lock(barrier_round_mutex_, std::try_to_lock);
+        if (!round_lock.owns_lock())
+        {
+            return true;
+        }
+        join_exited_();
+        if (grow)
+        {
+            try
+            {
+                add_thread_(0);
+            }
+            catch (...)
+            {
+                // keep going with the threads at hand
+            }
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        retire_this_thread_();
+        return false;
+    }
+
+    // reorder each run of log messages of the batch so its loggers take turns, up to
+    // fair_quantum_ messages of a logger at a time (if fair draining is enabled).
+    void fair_order_(worker_state &state, async_msg *batch, size_t dequeued)
+    {
+        size_t quantum = fair_quantum_.load(std::memory_order_relaxed);
+        if (quantum == 0 || dequeued < 2)
+        {
+            return;
+        }
+        for (size_t begin = 0; begin < dequeued;)
+        {
+            size_t end = begin;
+            while (end < dequeued && batch[end].msg_type == async_msg_type::log)
+            {
+                end++;
+            }
+            fair_order_run_(state, batch + begin, end - begin, quantum);
+            begin = end + 1;
+        }
+    }
+
+    static void fair_order_run_(worker_state &state, async_msg *run, size_t n, size_t quantum)
+    {
+        auto &loggers = state.fair_loggers;
+        auto &counts = state.fair_counts;
+        auto &keys = state.fair_keys;
+        loggers.clear();
+        counts.clear();
+        keys.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            auto logger = static_cast<size_t>(std::find(loggers.begin(), loggers.end(), run[i].worker_ptr) - loggers.begin());
+            if (logger == loggers.size())
+            {
+                loggers.push_back(run[i].worker_ptr);
+                counts.push_back(0);
+            }
+            keys.push_back(fair_key{counts[logger]++ / quantum, logger, i});
+        }
+        if (loggers.size() < 2)
+        {
+            return;
+        }
+        std::sort(keys.begin(), keys.end());
+        auto &scratch = state.fair_scratch;
+        scratch.resize(std::max(scratch.size(), n));
+        for (size_t i = 0; i < n; i++)
+        {
+            scratch[i] = std::move(run[keys[i].index]);
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            run[i] = std::move(scratch[i]);
+        }
+    }
+
+    // return false if a terminate msg was received
+    bool process_batch_(worker_state &state, async_msg *batch, size_t dequeued)
+    {
+        bool active = true;
+        // once the drain(..) deadline expired, log and flush messages are only discarded
+        bool discard = dequeued > 0 && past_drain_deadline_();
+        for (size_t i = 0; i < dequeued;)
+        {
+            auto &incoming_async_msg = batch[i];
+            switch (incoming_async_msg.msg_type)
+            {
+            case async_msg_type::log:
+            {
+                if (discard)
+                {
+                    discarded_.fetch_add(1, std::memory_order_relaxed);
+                    release_quotas_(&incoming_async_msg, 1);
+                    break;
+                }
+                i = process_log_run_(state, batch, i, dequeued);
+                continue;
+            }
+            case async_msg_type::flush:
+            {
+                if (discard)
+                {
+                    incoming_async_msg.flushed.reset();
+                    break;
+                }
+                // flush right away (keeping its order relative to the other messages)
+                // and drop the flush it would make redundant.
+                remove_pending_flush_(state.pending_flush, incoming_async_msg.worker_ptr);
+                incoming_async_msg.worker_ptr->backend_flush_();
+                if (incoming_async_msg.flushed)
+                {
+                    incoming_async_msg.flushed->set_value();
+                    incoming_async_msg.flushed.reset();
+                }
+                break;
+            }
+            case async_msg_type::barrier:
+            {
+                if (!state.barrier_passed)
+                {
+                    // give away the other barrier messages of this batch - each worker must get one.
+                    for (size_t j = i + 1; j < dequeued; j++)
+                    {
+                        if (batch[j].msg_type == async_msg_type::barrier)
+                        {
+                            enqueue_(state.q_index, async_msg(async_msg_type::barrier));
+                        }
+                    }
+                    flush_pending_(state);
+                    wait_barrier_();
+                    state.barrier_passed = true;
+                }
+                break;
+            }
+            case async_msg_type::terminate:
+            {
+                // each worker must get its own terminate msg.
+                // give away the ones that were drained in the same batch.
+                if (!active)
+                {
+                    enqueue_(state.q_index, async_msg(async_msg_type::terminate));
+                }
+                active = false;
+                break;
+            }
+            default:
+                assert(false && "Unexpected async_msg_type");
+            }
+            i++;
+        }
+        return active;
+    }
+
+    // dequeue from both lanes without waiting. the normal lane goes first: high lane
+    // messages logged before whatever it returned are then seen too.
+    bool try_dequeue_(worker_state &state)
+    {
+        auto zero = std::chrono::milliseconds::zero();
+        state.dequeued = state.q.dequeue_bulk_for(state.batch.data(), state.batch.size(), zero);
+        if (state.high_q != nullptr)
+        {
+            state.high_dequeued = state.high_q->dequeue_bulk_for(state.high_batch.data(), state.high_batch.size(), zero);
+        }
+        return state.dequeued + state.high_dequeued > 0;
+    }
+
+    // wait for the next messages according to the wait strategy, and put them in
+    // state.batch and state.high_batch. may dequeue nothing (after a timeout).
+    void dequeue_batch_(worker_state &state)
+    {
+        // number of checks with a cpu pause (then with a yield) in between, before parking
+        static const size_t spin_tries = 1024;
+        static const size_t yield_tries = 16;
+
+        state.dequeued = state.high_dequeued = 0;
+        auto &spill = *spills_[state.q_index];
+        if (spill.busy())
+        {
+            // what is in the queue came before the spill file's records
+            if (!try_dequeue_(state))
+            {
+                state.dequeued = spill.read(state.batch.data(), state.batch.size());
+                if (state.dequeued == 0)
+                {
+                    // a producer is about to append
+                    std::this_thread::yield();
+                }
+            }
+            return;
+        }
+        auto strategy = wait_strategy_.load(std::memory_order_relaxed);
+        if (strategy != async_wait_strategy::blocking)
+        {
+            for (size_t tries = 0;; tries++)
+            {
+                if (try_dequeue_(state))
+                {
+                    return;
+                }
+                if (tries < spin_tries || strategy == async_wait_strategy::busy_spin)
+                {
+                    os::cpu_relax();
+                }
+                else if (tries < spin_tries + yield_tries || strategy == async_wait_strategy::spin_yield)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
+
+        // wake up in time to publish the messages staged by idle producers
+        std::chrono::milliseconds park_timeout = std::chrono::seconds(10);
+        if (has_stages_.load(std::memory_order_relaxed))
+        {
+            park_timeout = std::chrono::milliseconds(batch_max_delay_.load(std::memory_order_relaxed));
+        }
+        if (autoscale_max_.load(std::memory_order_relaxed) > 0)
+        {
+            // and to retire once idle for long enough
+            park_timeout = std::min(park_timeout, std::chrono::milliseconds(autoscale_idle_.load(std::memory_order_relaxed)));
+        }
+
+        if (state.high_bell == nullptr)
+        {
+            state.dequeued = state.q.dequeue_bulk_for(state.batch.data(), state.batch.size(), park_timeout);
+            return;
+        }
+        auto &bell = *state.high_bell;
+        std::unique_lock<std::mutex> lock(bell.mutex);
+        bell.parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bell.cv.wait_for(lock, park_timeout, [this, &state] { return this->try_dequeue_(state); });
+        bell.parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void flush_pending_(worker_state &state)
+    {
+        for (auto &worker_ptr : state.pending_flush)
+        {
+            worker_ptr->backend_flush_();
+        }
+        state.pending_flush.clear();
+    }
+
+    // wait until all workers arrived at their barrier message
+    void wait_barrier_()
+    {
+        std::unique_lock<std::mutex> lock(barrier_mutex_);
+        if (++barrier_arrived_ == threads_n_.load(std::memory_order_relaxed))
+        {
+            barrier_arrived_ = 0;
+            barrier_generation_++;
+            lock.unlock();
+            barrier_cv_.notify_all();
+            return;
+        }
+        auto generation = barrier_generation_;
+        barrier_cv_.wait(lock, [this, generation] { return this->barrier_generation_ != generation; });
+    }
+
+    // pass the run of consecutive log messages of the same logger starting at batch[begin]
+    // to the logger's sinks at once.
+    // return the index of the first message after the run.
+    size_t process_log_run_(worker_state &state, async_msg *batch, size_t begin, size_t dequeued)
+    {
+        auto worker_ptr = batch[begin].worker_ptr;
+        auto &log_msgs = state.log_msgs;
+        log_msgs.clear();
+
+        bool should_flush = false;
+        size_t end = begin;
+        for (; end < dequeued && batch[end].msg_type == async_msg_type::log && batch[end].worker_ptr == worker_ptr; end++)
+        {
+            if (batch[end].deferred_fn != nullptr && !worker_ptr->backend_format_(batch[end], state.format_buf))
+            {
+                continue;
+            }
+            log_msgs.push_back(batch[end].to_log_msg());
+            should_flush = should_flush || worker_ptr->should_flush_(log_msgs.back());
+        }
+
+        if (log_msgs.size() == 1)
+        {
+            worker_ptr->backend_log_(log_msgs[0]);
+        }
+        else if (!log_msgs.empty())
+        {
+            worker_ptr->backend_log_batch_(log_msgs.data(), log_msgs.size());
+        }
+
+        if (should_flush)
+        {
+            add_pending_flush_(state.pending_flush, worker_ptr);
+        }
+        release_quotas_(batch + begin, end - begin);
+        return end;
+    }
+
+    static void add_pending_flush_(std::vector<async_logger_ptr> &pending_flush, async_logger_ptr worker_ptr)
+    {
+        for (auto &p : pending_flush)
+        {
+            if (p == worker_ptr)
+            {
+                return;
+            }
+        }
+        pending_flush.push_back(worker_ptr);
+    }
+
+    static void remove_pending_flush_(std::vector<async_logger_ptr> &pending_flush, async_logger_ptr worker_ptr)
+    {
+        auto it = std::find(pending_flush.begin(), pending_flush.end(), worker_ptr);
+        if (it != pending_flush.end())
+        {
+            pending_flush.erase(it);
         }
-        assert(false && "Unexpected async_msg_type");
-        return true;
     }
 };
 
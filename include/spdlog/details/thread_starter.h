@@ -0,0 +1,102 @@
+//
+// Copyright(c) 2018 Gabi Melman.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// starts the threads of spdlog (thread pool workers and the periodic flusher) with the
+// user's thread_options applied.
+
+#include "spdlog/common.h"
+#include "spdlog/details/os.h"
+
+#include <exception>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+// apply the options to the calling thread, which is the index-th of its kind
+inline void apply_thread_options(const thread_options &options, size_t index, bool numbered_name)
+{
+    if (!options.cpu_affinity.empty())
+    {
+        os::set_thread_affinity(options.cpu_affinity[index % options.cpu_affinity.size()]);
+    }
+    if (!options.name.empty())
+    {
+        os::set_thread_name(numbered_name ? options.name + std::to_string(index) : options.name);
+    }
+    if (options.sched_policy >= 0)
+    {
+        os::set_thread_scheduling(options.sched_policy, options.sched_priority);
+    }
+    if (options.on_start)
+    {
+        options.on_start(index);
+    }
+}
+
+// start a thread that applies the options, runs body() and then calls options.on_stop(index).
+// wait until the thread applied the options, and if it failed rethrow the error (the
+// thread doesn't run body() and is joined).
+// numbered_name: append the index to the thread's name (for the threads of a pool).
+template<typename Body>
+inline std::thread start_thread(const thread_options &options, size_t index, bool numbered_name, Body body)
+{
+    // shared with the thread, which may still be in set_value() when the creator returns
+    auto started = std::make_shared<std::promise<void>>();
+    auto started_future = started->get_future();
+    std::thread t([&options, started, index, numbered_name, body]() {
+        try
+        {
+            apply_thread_options(options, index, numbered_name);
+        }
+        catch (...)
+        {
+            started->set_exception(std::current_exception());
+            return;
+        }
+        // copy it before the creator may return (and options go away)
+        auto on_stop = options.on_stop;
+        started->set_value();
+        body();
+        if (on_stop)
+        {
+            try
+            {
+                on_stop(index);
+            }
+            catch (...)
+            {
+            }
+        }
+    });
+
+    try
+    {
+        started_future.get();
+    }
+    catch (const spdlog_ex &)
+    {
+        t.join();
+        throw;
+    }
+    catch (const std::exception &ex)
+    {
+        t.join();
+        throw spdlog_ex(std::string("thread on_start failed: ") + ex.what());
+    }
+    catch (...)
+    {
+        t.join();
+        throw spdlog_ex("thread on_start failed");
+    }
+    return t;
+}
+} // namespace details
+} // namespace spdlog
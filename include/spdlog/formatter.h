@@ -16,5 +16,12 @@ public:
     virtual ~formatter() = default;
     virtual void format(const details::log_msg &msg, fmt::memory_buffer &dest) = 0;
     virtual std::unique_ptr<formatter> clone() const = 0;
+
+    // formatters with the same non empty key format any message the same way,
+    // so sinks may share their output (see details::shared_format). empty if unknown.
+    virtual string_view_t format_key() const
+    {
+        return {};
+    }
 };
 } // namespace spdlog
@@ -19,9 +19,11 @@
 // and support customize format per each sink.
 
 #include "spdlog/common.h"
+#include "spdlog/details/deferred_args.h"
 #include "spdlog/formatter.h"
 #include "spdlog/sinks/sink.h"
 
+#include <future>
 #include <locale>
 #include <memory>
 #include <string>
@@ -150,6 +152,11 @@ public:
     // flush functions
     void flush();
     void flush_on(level::level_enum log_level);
+
+    // flush, and get a future that is ready once the sinks flushed everything logged
+    // before (right away, except for async loggers).
+    // if the flush fails, or is dropped by a full async queue, the future gets a broken promise.
+    std::future<void> flush_with_future();
     level::level_enum flush_level() const;
 
     // sinks
@@ -167,6 +174,14 @@ protected:
     virtual void sink_it_(details::log_msg &msg);
     virtual void flush_();
 
+    // flush_() that sets flushed once done. the default flushes right away.
+    virtual void flush_with_future_(std::unique_ptr<std::promise<void>> flushed);
+
+    // called instead of sink_it_(..) when defer_formatting_ is set and the arguments of the
+    // log call were captured into msg.payload (see deferred_args.h) - format_fn formats them.
+    // the default formats them right away.
+    virtual void sink_it_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn);
+
     bool should_flush_(const details::log_msg &msg);
 
     // default error handler.
@@ -183,6 +198,7 @@ protected:
     log_err_handler err_handler_{[this](const std::string &msg) { this->default_err_handler_(msg); }};
     std::atomic<time_t> last_err_time_{0};
     std::atomic<size_t> msg_counter_{1};
+    std::atomic<bool> defer_formatting_{false};
 };
 } // namespace spdlog
 
@@ -97,22 +97,14 @@ public:
 
         fmt::memory_buffer formatted;
         formatter_->format(msg, formatted);
-        if (should_do_colors_ && msg.color_range_end > msg.color_range_start)
-        {
-            // before color range
-            print_range_(formatted, 0, msg.color_range_start);
-            // in color range
-            print_ccode_(colors_[msg.level]);
-            print_range_(formatted, msg.color_range_start, msg.color_range_end);
-            print_ccode_(reset);
-            // after color range
-            print_range_(formatted, msg.color_range_end, formatted.size());
-        }
-        else // no color
-        {
-            print_range_(formatted, 0, formatted.size());
-        }
-        fflush(target_file_);
+        print_(msg, formatted);
+    }
+
+    // the color range of the shared text is set on msg as well
+    void log_shared(const details::log_msg &msg, details::shared_format &shared) override
+    {
+        std::lock_guard<mutex_t> lock(mutex_);
+        print_(msg, shared.format(*formatter_));
     }
 
     void flush() override
@@ -134,6 +126,26 @@ public:
     }
 
 private:
+    void print_(const details::log_msg &msg, const fmt::memory_buffer &formatted)
+    {
+        if (should_do_colors_ && msg.color_range_end > msg.color_range_start)
+        {
+            // before color range
+            print_range_(formatted, 0, msg.color_range_start);
+            // in color range
+            print_ccode_(colors_[msg.level]);
+            print_range_(formatted, msg.color_range_start, msg.color_range_end);
+            print_ccode_(reset);
+            // after color range
+            print_range_(formatted, msg.color_range_end, formatted.size());
+        }
+        else // no color
+        {
+            print_range_(formatted, 0, formatted.size());
+        }
+        fflush(target_file_);
+    }
+
     void print_ccode_(const std::string &color_code)
     {
         fwrite(color_code.data(), sizeof(char), color_code.size(), target_file_);
@@ -6,7 +6,9 @@
 #pragma once
 //
 // base sink templated over a mutex (either dummy or real)
-// concrete implementation should override the sink_it_() and flush_()  methods.
+// concrete implementation should override the sink_it_() and flush_()  methods,
+// and optionally sink_it_batch_() to write many messages at once, and sink_shared_()
+// to write the text formatted for other sinks too.
 // locking is taken care of in this class - no locking needed by the
 // implementers..
 //
@@ -32,6 +34,18 @@ public:
         sink_it_(msg);
     }
 
+    void log_batch(const details::log_msg *msgs, size_t count) final
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        sink_it_batch_(msgs, count);
+    }
+
+    void log_shared(const details::log_msg &msg, details::shared_format &shared) final
+    {
+        std::lock_guard<Mutex> lock(mutex_);
+        sink_shared_(msg, shared);
+    }
+
     void flush() final
     {
         std::lock_guard<Mutex> lock(mutex_);
@@ -54,6 +68,20 @@ protected:
     virtual void sink_it_(const details::log_msg &msg) = 0;
     virtual void flush_() = 0;
 
+    virtual void sink_it_batch_(const details::log_msg *msgs, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            sink_it_(msgs[i]);
+        }
+    }
+
+    // sinks that write the formatted text as is, take it from shared.format(*formatter_)
+    virtual void sink_shared_(const details::log_msg &msg, details::shared_format &)
+    {
+        sink_it_(msg);
+    }
+
     virtual void set_pattern_(const std::string &pattern)
     {
         set_formatter_(details::make_unique<spdlog::pattern_formatter>(pattern));
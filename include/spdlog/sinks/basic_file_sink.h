@@ -38,6 +38,22 @@ protected:
         file_helper_.write(formatted);
     }
 
+    void sink_shared_(const details::log_msg &, details::shared_format &shared) override
+    {
+        file_helper_.write(shared.format(*sink::formatter_));
+    }
+
+    // format all messages into one buffer and write it at once
+    void sink_it_batch_(const details::log_msg *msgs, size_t count) override
+    {
+        fmt::memory_buffer formatted;
+        for (size_t i = 0; i < count; i++)
+        {
+            sink::formatter_->format(msgs[i], formatted);
+        }
+        file_helper_.write(formatted);
+    }
+
     void flush_() override
     {
         file_helper_.flush();
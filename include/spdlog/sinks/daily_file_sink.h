@@ -66,27 +66,58 @@ public:
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
-
-        if (msg.time >= rotation_tp_)
-        {
-            file_helper_.open(FileNameCalc::calc_filename(base_filename_, now_tm(msg.time)), truncate_);
-            rotation_tp_ = next_rotation_tp_();
-        }
+        rotate_if_due_(msg);
         fmt::memory_buffer formatted;
         sink::formatter_->format(msg, formatted);
         file_helper_.write(formatted);
     }
 
+    void sink_shared_(const details::log_msg &msg, details::shared_format &shared) override
+    {
+        rotate_if_due_(msg);
+        file_helper_.write(shared.format(*sink::formatter_));
+    }
+
+    // format the messages into one buffer and write it at once.
+    // if a message is past the rotation time, write what we have so far and rotate.
+    void sink_it_batch_(const details::log_msg *msgs, size_t count) override
+    {
+        fmt::memory_buffer formatted;
+        size_t written = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto &msg = msgs[i];
+            if (msg.time >= rotation_tp_)
+            {
+                file_helper_.write(formatted.data() + written, formatted.size() - written);
+                written = formatted.size();
+                file_helper_.open(FileNameCalc::calc_filename(base_filename_, now_tm(msg.time)), truncate_);
+                rotation_tp_ = next_rotation_tp_();
+            }
+            sink::formatter_->format(msg, formatted);
+        }
+        file_helper_.write(formatted.data() + written, formatted.size() - written);
+    }
+
     void flush_() override
     {
         file_helper_.flush();
     }
 
 private:
+    void rotate_if_due_(const details::log_msg &msg)
+    {
+        if (msg.time >= rotation_tp_)
+        {
+            file_helper_.open(FileNameCalc::calc_filename(base_filename_, now_tm(msg.time)), truncate_);
+            rotation_tp_ = next_rotation_tp_();
+        }
+    }
+
     tm now_tm(log_clock::time_point tp)
     {
         time_t tnow = log_clock::to_time_t(tp);
-        return spdlog::details::os::localtime(tnow);
+        return spdlog::details::local_time::localtime(tnow);
     }
 
     log_clock::time_point next_rotation_tp_()
@@ -53,12 +53,43 @@ public:
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
+        details::shared_format shared(msg);
+        sink_shared_(msg, shared);
+    }
 
+    // the sub sinks share the formatted text with each other, and with the sinks of the logger
+    void sink_shared_(const details::log_msg &msg, details::shared_format &shared) override
+    {
         for (auto &sink : sinks_)
         {
             if (sink->should_log(msg.level))
             {
-                sink->log(msg);
+                sink->log_shared(msg, shared);
+            }
+        }
+    }
+
+    void sink_it_batch_(const details::log_msg *msgs, size_t count) override
+    {
+        auto min_level = level::off;
+        for (size_t i = 0; i < count; i++)
+        {
+            min_level = std::min(min_level, msgs[i].level);
+        }
+
+        for (auto &sink : sinks_)
+        {
+            if (sink->should_log(min_level))
+            {
+                sink->log_batch(msgs, count);
+                continue;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if (sink->should_log(msgs[i].level))
+                {
+                    sink->log(msgs[i]);
+                }
             }
         }
     }
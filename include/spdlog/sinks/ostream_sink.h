@@ -34,6 +34,16 @@ protected:
     {
         fmt::memory_buffer formatted;
         sink::formatter_->format(msg, formatted);
+        write_(formatted);
+    }
+
+    void sink_shared_(const details::log_msg &, details::shared_format &shared) override
+    {
+        write_(shared.format(*sink::formatter_));
+    }
+
+    void write_(const fmt::memory_buffer &formatted)
+    {
         ostream_.write(formatted.data(), static_cast<std::streamsize>(formatted.size()));
         if (force_flush_)
         {
@@ -63,13 +63,35 @@ protected:
     {
         fmt::memory_buffer formatted;
         sink::formatter_->format(msg, formatted);
-        current_size_ += formatted.size();
-        if (current_size_ > max_size_)
+        write_(formatted);
+    }
+
+    void sink_shared_(const details::log_msg &, details::shared_format &shared) override
+    {
+        write_(shared.format(*sink::formatter_));
+    }
+
+    // format the messages into one buffer and write it at once.
+    // if a message would exceed the max size, write what we have so far and rotate.
+    void sink_it_batch_(const details::log_msg *msgs, size_t count) override
+    {
+        fmt::memory_buffer formatted;
+        size_t written = 0;
+        for (size_t i = 0; i < count; i++)
         {
-            rotate_();
-            current_size_ = formatted.size();
+            auto msg_start = formatted.size();
+            sink::formatter_->format(msgs[i], formatted);
+            auto msg_size = formatted.size() - msg_start;
+            current_size_ += msg_size;
+            if (current_size_ > max_size_)
+            {
+                file_helper_.write(formatted.data() + written, msg_start - written);
+                written = msg_start;
+                rotate_();
+                current_size_ = msg_size;
+            }
         }
-        file_helper_.write(formatted);
+        file_helper_.write(formatted.data() + written, formatted.size() - written);
     }
 
     void flush_() override
@@ -78,6 +100,17 @@ protected:
     }
 
 private:
+    void write_(const fmt::memory_buffer &formatted)
+    {
+        current_size_ += formatted.size();
+        if (current_size_ > max_size_)
+        {
+            rotate_();
+            current_size_ = formatted.size();
+        }
+        file_helper_.write(formatted);
+    }
+
     // Rotate files:
     // log.txt -> log.1.txt
     // log.1.txt -> log.2.txt
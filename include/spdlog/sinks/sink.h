@@ -7,6 +7,7 @@
 
 #include "spdlog/details/log_msg.h"
 #include "spdlog/details/pattern_formatter.h"
+#include "spdlog/details/shared_format.h"
 #include "spdlog/formatter.h"
 
 namespace spdlog {
@@ -28,6 +29,25 @@ public:
 
     virtual ~sink() = default;
     virtual void log(const details::log_msg &msg) = 0;
+
+    // log a contiguous range of messages (the caller checks should_log(..) for each of them).
+    // sinks that can write many messages at once override it - by default they are logged one by one.
+    virtual void log_batch(const details::log_msg *msgs, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            log(msgs[i]);
+        }
+    }
+
+    // log the message, formatted once for all the sinks of the logger with an equivalent
+    // formatter (see details::shared_format). sinks that write the formatted text as is
+    // override it - by default the message is logged as usual.
+    virtual void log_shared(const details::log_msg &msg, details::shared_format &)
+    {
+        log(msg);
+    }
+
     virtual void flush() = 0;
     virtual void set_pattern(const std::string &pattern) = 0;
     virtual void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) = 0;
@@ -40,8 +40,13 @@ public:
         std::lock_guard<mutex_t> lock(mutex_);
         fmt::memory_buffer formatted;
         formatter_->format(msg, formatted);
-        fwrite(formatted.data(), sizeof(char), formatted.size(), file_);
-        fflush(TargetStream::stream());
+        write_(formatted);
+    }
+
+    void log_shared(const details::log_msg &, details::shared_format &shared) override
+    {
+        std::lock_guard<mutex_t> lock(mutex_);
+        write_(shared.format(*formatter_));
     }
 
     void flush() override
@@ -63,6 +68,12 @@ public:
     }
 
 private:
+    void write_(const fmt::memory_buffer &formatted)
+    {
+        fwrite(formatted.data(), sizeof(char), formatted.size(), file_);
+        fflush(TargetStream::stream());
+    }
+
     mutex_t &mutex_;
     FILE *file_;
 };
@@ -87,6 +87,12 @@ inline void flush_every(std::chrono::seconds interval)
     details::registry::instance().flush_every(interval);
 }
 
+// Same, with the flusher thread placed according to options (see thread_options)
+inline void flush_every(std::chrono::seconds interval, const thread_options &options)
+{
+    details::registry::instance().flush_every(interval, options);
+}
+
 // Set global error handler
 inline void set_error_handler(log_err_handler handler)
 {
@@ -107,6 +113,12 @@ inline void apply_all(const std::function<void(std::shared_ptr<logger>)> &fun)
     details::registry::instance().apply_all(fun);
 }
 
+// Flush all registered loggers and wait until they are done (async loggers included)
+inline void flush_all_and_wait()
+{
+    details::registry::instance().flush_all_and_wait();
+}
+
 // Drop the reference to the given logger
 inline void drop(const std::string &name)
 {
@@ -125,6 +137,14 @@ inline void shutdown()
     details::registry::instance().shutdown();
 }
 
+// drain the global thread pool within drain_timeout (see thread_pool::drain(..)), then
+// stop any running threads started by spdlog and clean registry loggers.
+// return the number of async log messages discarded by the drain.
+inline size_t shutdown(std::chrono::milliseconds drain_timeout)
+{
+    return details::registry::instance().shutdown(drain_timeout);
+}
+
 // Automatic registration of loggers when using spdlog::create() or spdlog::create_async
 inline void set_automatic_registration(bool automatic_registation)
 {
@@ -128,6 +128,34 @@
 // #define SPDLOG_DISABLE_DEFAULT_LOGGER
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to use a lock free queue in the async thread pool instead of the
+// default mutex protected one.
+// Scales better when many threads log to async loggers concurrently.
+//
+// #define SPDLOG_LOCKFREE_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to give each thread logging to async loggers its own queue
+// (of the thread pool's queue size) instead of a single shared queue.
+// The thread pool merges the per thread queues by message time.
+// Producers never share a cache line, at the cost of more memory per thread.
+// Takes precedence over SPDLOG_LOCKFREE_QUEUE.
+//
+// #define SPDLOG_PER_THREAD_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to store async messages as variable length records in a single
+// byte ring instead of fixed size slots. Short messages take only the room
+// they need and long ones are never heap allocated.
+// The thread pool's queue size is then given in bytes, not messages.
+// Takes precedence over SPDLOG_PER_THREAD_QUEUE and SPDLOG_LOCKFREE_QUEUE.
+//
+// #define SPDLOG_BYTE_RING_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 // Uncomment and set to compile time level with zero cost (default is INFO).
 // Macros like SPDLOG_DEBUG(..), SPDLOG_INFO(..)  will expand to empty statements if not enabled
@@ -193,3 +193,942 @@ TEST_CASE("to_file multi-workers", "[async]")
 
     REQUIRE(count_lines(filename) == messages);
 }
+
+TEST_CASE("batch drain", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t queue_size = 1024;
+    size_t messages = 1024;
+    size_t batch_size = 64;
+    {
+        auto tp = std::make_shared<details::thread_pool>(queue_size, 1, batch_size);
+        auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block);
+        logger->flush_on(level::info);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+    }
+    REQUIRE(test_sink->msg_counter() == messages);
+    // flush_on(..) flushes are coalesced - at most one per batch
+    REQUIRE(test_sink->flush_counter() >= messages / batch_size);
+    REQUIRE(test_sink->flush_counter() <= messages);
+}
+
+TEST_CASE("batch drain multi-workers", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t messages = 1024;
+    {
+        auto tp = std::make_shared<details::thread_pool>(messages, 4, 128);
+        auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+        logger->flush();
+    }
+    REQUIRE(test_sink->msg_counter() == messages);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("batch to_file", "[async]")
+{
+    prepare_logdir();
+    size_t messages = 1024;
+    std::string filename = "logs/async_test.log";
+    {
+        auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(filename, true);
+        auto tp = std::make_shared<spdlog::details::thread_pool>(messages, 1, 64);
+        auto logger = std::make_shared<spdlog::async_logger>("as", std::move(file_sink), std::move(tp));
+
+        for (size_t j = 0; j < messages; j++)
+        {
+            logger->info("Hello message #{}", j);
+        }
+    }
+
+    REQUIRE(count_lines(filename) == messages);
+    auto contents = file_contents(filename);
+    REQUIRE(ends_with(contents, std::string("Hello message #1023\n")));
+}
+
+TEST_CASE("deferred formatting", "[async]")
+{
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%v");
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1, 16);
+        auto logger = std::make_shared<spdlog::async_logger>("as", oss_sink, tp);
+        logger->set_deferred_formatting(true);
+        REQUIRE(logger->deferred_formatting());
+
+        std::string temp("temporary");
+        char buf[] = "buffer";
+        logger->info("{} {} {:.1f} {} {}", 1, 'c', 2.5, true, "literal");
+        logger->info("{} {} {}", temp, spdlog::string_view_t("view"), buf);
+        temp = "changed";
+        buf[0] = 'X';
+        // pointers (other than char pointers) are not captured - formatted by the caller
+        logger->info("{} {}", static_cast<const void *>(nullptr), 6);
+        logger->info("{:>4}|{:<3}|", 42, "ab");
+    }
+    REQUIRE(oss.str() == "1 c 2.5 true literal\ntemporary view buffer\n0x0 6\n  42|ab |\n");
+}
+
+TEST_CASE("deferred formatting error", "[async]")
+{
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%v");
+    std::atomic<int> errors{0};
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+        auto logger = std::make_shared<spdlog::async_logger>("as", oss_sink, tp);
+        logger->set_deferred_formatting(true);
+        logger->set_error_handler([&errors](const std::string &) { errors++; });
+
+        // the bad format string is detected by the worker
+        logger->info("Bad format msg {} {}", "xxx");
+        logger->info("Good msg {}", 1);
+        const char *null_str = nullptr;
+        logger->info("Null {}", null_str);
+    }
+    REQUIRE(errors == 2);
+    REQUIRE(oss.str() == "Good msg 1\n");
+}
+
+TEST_CASE("logger destroyed before its messages are processed", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 100;
+
+    auto tp = std::make_shared<details::thread_pool>(messages, 3, 4);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    // the destructor waits for the pool to be done with the logger's messages
+    logger.reset();
+    REQUIRE(test_sink->msg_counter() == messages);
+}
+
+TEST_CASE("loggers destroyed concurrently", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t n_threads = 4;
+    size_t messages = 200;
+    {
+        auto tp = std::make_shared<details::thread_pool>(64, 3, 8);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n_threads; t++)
+        {
+            threads.emplace_back([&tp, &test_sink, messages] {
+                for (int round = 0; round < 5; round++)
+                {
+                    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block);
+                    for (size_t i = 0; i < messages; i++)
+                    {
+                        logger->info("Hello message #{}", i);
+                    }
+                }
+            });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        REQUIRE(test_sink->msg_counter() == n_threads * 5 * messages);
+    }
+}
+
+TEST_CASE("sharded thread pool", "[async]")
+{
+    using namespace spdlog;
+    size_t n_loggers = 4;
+    size_t messages = 500;
+    std::vector<std::ostringstream> outputs(n_loggers);
+    {
+        auto tp = std::make_shared<details::thread_pool>(16, 4, 8, async_queue_sharding::per_thread);
+        std::vector<std::shared_ptr<async_logger>> loggers;
+        for (size_t i = 0; i < n_loggers; i++)
+        {
+            auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(outputs[i]);
+            oss_sink->set_pattern("%v");
+            loggers.push_back(std::make_shared<async_logger>("as" + std::to_string(i), oss_sink, tp));
+            loggers.back()->set_shard(i);
+        }
+        for (size_t j = 0; j < messages; j++)
+        {
+            for (auto &logger : loggers)
+            {
+                logger->info("{}", j);
+            }
+        }
+        for (auto &logger : loggers)
+        {
+            logger->flush();
+        }
+        REQUIRE(tp->overrun_counter() == 0);
+    }
+
+    // each logger's messages were processed in order by its own thread
+    std::string expected;
+    for (size_t j = 0; j < messages; j++)
+    {
+        expected += std::to_string(j) + "\n";
+    }
+    for (auto &output : outputs)
+    {
+        REQUIRE(output.str() == expected);
+    }
+}
+
+TEST_CASE("sharded thread pool shard", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(16, 2, 1, spdlog::async_queue_sharding::per_thread);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    REQUIRE(logger->shard() == std::hash<std::string>()("as"));
+    logger->set_shard(7);
+    REQUIRE(std::static_pointer_cast<spdlog::async_logger>(logger->clone("as3"))->shard() == 7);
+}
+
+TEST_CASE("wait strategies", "[async]")
+{
+    using spdlog::async_wait_strategy;
+    size_t messages = 1024;
+    for (auto strategy : {async_wait_strategy::blocking, async_wait_strategy::spin_then_park, async_wait_strategy::spin_yield,
+             async_wait_strategy::busy_spin})
+    {
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        {
+            auto tp = std::make_shared<spdlog::details::thread_pool>(16, 2);
+            tp->set_wait_strategy(strategy);
+            REQUIRE(tp->wait_strategy() == strategy);
+            auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, spdlog::async_overflow_policy::block);
+            for (size_t i = 0; i < messages; i++)
+            {
+                logger->info("Hello message #{}", i);
+                if (i % 256 == 0)
+                {
+                    // let the workers find the queue empty
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            logger->flush();
+        }
+        REQUIRE(test_sink->msg_counter() == messages);
+        REQUIRE(test_sink->flush_counter() == 1);
+    }
+}
+
+TEST_CASE("priority lane keeps high level messages", "[async]")
+{
+    using namespace spdlog;
+    size_t messages = 1024;
+    std::ostringstream oss;
+    auto slow_sink = std::make_shared<sinks::test_sink_mt>();
+    slow_sink->set_delay(std::chrono::milliseconds(1));
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%l");
+    size_t high_overruns = 0;
+    size_t normal_overruns = 0;
+    {
+        async_priority_lane high_lane;
+        high_lane.q_max_items = 1024;
+        high_lane.min_level = level::err;
+        auto tp = std::make_shared<details::thread_pool>(4, 1, 1, async_queue_sharding::shared, high_lane);
+        auto logger = std::make_shared<async_logger>("as", sinks_init_list{slow_sink, oss_sink}, tp, async_overflow_policy::overrun_oldest);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message");
+            if (i % 64 == 0)
+            {
+                logger->error("Error message");
+            }
+        }
+        logger->flush();
+        high_overruns = tp->overrun_counter(async_lane::high);
+        normal_overruns = tp->overrun_counter(async_lane::normal);
+        REQUIRE(tp->overrun_counter() == high_overruns + normal_overruns);
+    }
+    REQUIRE(high_overruns == 0);
+    REQUIRE(normal_overruns > 0);
+    auto output = oss.str();
+    size_t errors = 0;
+    for (auto pos = output.find("error"); pos != std::string::npos; pos = output.find("error", pos + 1))
+    {
+        errors++;
+    }
+    REQUIRE(errors == messages / 64);
+}
+
+TEST_CASE("priority lane goes first", "[async]")
+{
+    using namespace spdlog;
+    size_t messages = 200;
+    std::ostringstream oss;
+    auto slow_sink = std::make_shared<sinks::test_sink_mt>();
+    slow_sink->set_delay(std::chrono::milliseconds(1));
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%v");
+    {
+        async_priority_lane high_lane;
+        high_lane.q_max_items = 16;
+        auto tp = std::make_shared<details::thread_pool>(details::default_async_q_size, 1, 1, async_queue_sharding::shared, high_lane);
+        auto logger = std::make_shared<async_logger>("as", sinks_init_list{slow_sink, oss_sink}, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("info");
+        }
+        logger->warn("warn");
+        logger->info("last");
+    }
+    auto output = oss.str();
+    // the warning jumped ahead of most of the queued messages, but not after the later one
+    REQUIRE(output.find("warn") < output.size() / 2);
+    REQUIRE(output.substr(output.size() - 5) == "last\n");
+}
+
+TEST_CASE("flush with future", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 64;
+    auto tp = std::make_shared<details::thread_pool>(128, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    auto flushed = logger->flush_with_future();
+    flushed.get();
+    REQUIRE(test_sink->msg_counter() == messages);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("flush all and wait", "[async]")
+{
+    using namespace spdlog;
+    spdlog::drop_all();
+    auto async_sink = std::make_shared<sinks::test_sink_mt>();
+    async_sink->set_delay(std::chrono::milliseconds(1));
+    auto sync_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t messages = 32;
+    auto tp = std::make_shared<details::thread_pool>(128, 1);
+    auto async = std::make_shared<async_logger>("as", async_sink, tp);
+    auto sync = std::make_shared<logger>("sync", sync_sink);
+    spdlog::register_logger(async);
+    spdlog::register_logger(sync);
+    for (size_t i = 0; i < messages; i++)
+    {
+        async->info("Hello message #{}", i);
+        sync->info("Hello message #{}", i);
+    }
+    spdlog::flush_all_and_wait();
+    REQUIRE(async_sink->msg_counter() == messages);
+    REQUIRE(async_sink->flush_counter() == 1);
+    REQUIRE(sync_sink->flush_counter() == 1);
+    spdlog::drop_all();
+}
+
+TEST_CASE("drain with deadline", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(10));
+    size_t messages = 200;
+    auto tp = std::make_shared<details::thread_pool>(1024, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto discarded = tp->drain(std::chrono::milliseconds(50));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(elapsed < std::chrono::seconds(1));
+    REQUIRE(discarded > 0);
+    auto processed = test_sink->msg_counter();
+    auto expected = messages - discarded;
+    REQUIRE(processed == expected);
+
+    // not accepted anymore
+    logger->info("Hello again");
+    auto expected_discarded = discarded + 1;
+    REQUIRE(tp->drain(std::chrono::milliseconds(0)) == expected_discarded);
+    REQUIRE(test_sink->msg_counter() == processed);
+}
+
+TEST_CASE("drain everything", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t messages = 256;
+    auto tp = std::make_shared<details::thread_pool>(128, 2);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->drain(std::chrono::milliseconds::max()) == 0);
+    REQUIRE(test_sink->msg_counter() == messages);
+}
+
+TEST_CASE("shutdown with drain timeout", "[async]")
+{
+    using namespace spdlog;
+    spdlog::init_thread_pool(1024, 1);
+    auto logger = spdlog::create_async<sinks::test_sink_mt>("as_shutdown");
+    auto test_sink = std::static_pointer_cast<sinks::test_sink_mt>(logger->sinks()[0]);
+    test_sink->set_delay(std::chrono::milliseconds(10));
+    size_t messages = 200;
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    auto discarded = spdlog::shutdown(std::chrono::milliseconds(50));
+    REQUIRE(discarded > 0);
+    auto processed = test_sink->msg_counter();
+    auto expected = messages - discarded;
+    REQUIRE(processed == expected);
+    REQUIRE(spdlog::thread_pool() == nullptr);
+}
+
+TEST_CASE("thread options", "[async]")
+{
+    using namespace spdlog;
+    std::atomic<size_t> started{0}, stopped{0};
+    std::atomic<bool> named{true};
+    thread_options options;
+    options.cpu_affinity = {{0}};
+    options.name = "spdlog_w";
+    options.on_start = [&](size_t index) {
+        started += index + 1;
+#ifdef __linux__
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        if (std::string(name) != "spdlog_w" + std::to_string(index))
+        {
+            named = false;
+        }
+#endif
+    };
+    options.on_stop = [&](size_t index) { stopped += index + 1; };
+
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    {
+        auto tp = std::make_shared<details::thread_pool>(128, 3, options);
+        REQUIRE(started == 6u);
+        auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+        logger->info("Hello message");
+    }
+    REQUIRE(stopped == 6u);
+    REQUIRE(named);
+    REQUIRE(test_sink->msg_counter() == 1);
+}
+
+TEST_CASE("thread options failure", "[async]")
+{
+    using namespace spdlog;
+    std::atomic<size_t> stopped{0};
+    thread_options options;
+    options.on_start = [](size_t index) {
+        if (index == 1)
+        {
+            throw std::runtime_error("no thread for you");
+        }
+    };
+    options.on_stop = [&](size_t) { stopped++; };
+    REQUIRE_THROWS_AS(std::make_shared<details::thread_pool>(128, 2, options), const spdlog_ex &);
+    // the thread that started fine was stopped again
+    REQUIRE(stopped == 1u);
+
+#ifdef __linux__
+    thread_options bad_cpu;
+    bad_cpu.cpu_affinity = {{100000}};
+    REQUIRE_THROWS_AS(std::make_shared<details::thread_pool>(128, 1, bad_cpu), const spdlog_ex &);
+#endif
+}
+
+TEST_CASE("periodic worker thread options", "[async]")
+{
+    using namespace spdlog;
+    std::atomic<int> started{0}, stopped{0};
+    thread_options options;
+    options.on_start = [&](size_t) { started++; };
+    options.on_stop = [&](size_t) { stopped++; };
+    {
+        details::periodic_worker worker([] {}, std::chrono::seconds(1), options);
+        REQUIRE(started == 1);
+    }
+    REQUIRE(stopped == 1);
+}
+
+TEST_CASE("locked queue memory", "[async]")
+{
+    using namespace spdlog;
+    async_queue_memory memory;
+    memory.lock = true;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t messages = 256;
+    {
+        // small enough for the default RLIMIT_MEMLOCK
+        auto tp = std::make_shared<details::thread_pool>(64, 1, memory);
+        auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+    }
+    REQUIRE(test_sink->msg_counter() == messages);
+}
+
+TEST_CASE("queue telemetry", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 100;
+    auto tp = std::make_shared<details::thread_pool>(16, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+    REQUIRE(test_sink->msg_counter() == messages);
+
+    auto stats = tp->telemetry();
+    REQUIRE(stats.queues.size() == 1);
+    REQUIRE(stats.high_queues.empty());
+    auto &q_stats = stats.queues[0];
+    // the log messages and the barrier of wait_processed()
+    auto expected_enqueued = messages + 1;
+    REQUIRE(q_stats.enqueued == expected_enqueued);
+    REQUIRE(q_stats.dequeued == expected_enqueued);
+    REQUIRE(q_stats.depth == 0);
+    REQUIRE(q_stats.overruns == 0);
+    REQUIRE(q_stats.high_water_mark > 0);
+    REQUIRE(q_stats.high_water_mark <= messages);
+
+    // the producer outran the slow sink, so it had to wait
+    size_t waits = 0;
+    for (auto n : q_stats.blocked_waits)
+    {
+        waits += n;
+    }
+    REQUIRE(waits > 0);
+    REQUIRE(q_stats.blocked_time > std::chrono::nanoseconds::zero());
+}
+
+TEST_CASE("overruns per logger", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 256;
+    auto tp = std::make_shared<details::thread_pool>(16, 1);
+    auto logger1 = std::make_shared<async_logger>("as1", test_sink, tp, async_overflow_policy::overrun_oldest);
+    auto logger2 = std::make_shared<async_logger>("as2", test_sink, tp, async_overflow_policy::overrun_oldest);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger1->info("Hello message #{}", i);
+        logger2->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+
+    auto overruns = tp->telemetry().queues[0].overruns;
+    REQUIRE(overruns > 0);
+    REQUIRE(tp->overrun_counter() == overruns);
+    auto per_logger = logger1->overrun_counter() + logger2->overrun_counter();
+    REQUIRE(per_logger == overruns);
+    auto processed = test_sink->msg_counter() + overruns;
+    REQUIRE(processed == 2 * messages);
+}
+
+TEST_CASE("block with timeout", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(5));
+    size_t messages = 50;
+    auto tp = std::make_shared<details::thread_pool>(4, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::block_with_timeout);
+    logger->set_block_timeout(std::chrono::milliseconds(1));
+    REQUIRE(logger->block_timeout() == std::chrono::milliseconds(1));
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+
+    auto stats = tp->telemetry().queues[0];
+    REQUIRE(stats.timeouts > 0);
+    REQUIRE(stats.discarded_new == 0);
+    REQUIRE(stats.overruns == 0);
+    REQUIRE(stats.blocked_time > std::chrono::nanoseconds::zero());
+    auto processed = test_sink->msg_counter() + stats.timeouts;
+    REQUIRE(processed == messages);
+}
+
+TEST_CASE("discard new", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(5));
+    size_t messages = 50;
+    auto tp = std::make_shared<details::thread_pool>(4, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::discard_new);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+
+    auto stats = tp->telemetry().queues[0];
+    REQUIRE(stats.discarded_new > 0);
+    REQUIRE(stats.timeouts == 0);
+    REQUIRE(stats.overruns == 0);
+    auto processed = test_sink->msg_counter() + stats.discarded_new;
+    REQUIRE(processed == messages);
+}
+
+TEST_CASE("spill file", "[async]")
+{
+    using namespace spdlog;
+    prepare_logdir();
+    std::string spill_filename = "logs/async_spill";
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%v");
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 100;
+    std::string expected;
+    {
+        auto tp = std::make_shared<details::thread_pool>(4, 1);
+        tp->set_spill_file(spill_filename);
+        REQUIRE_THROWS_AS(tp->set_spill_file(spill_filename), const spdlog_ex &);
+        auto logger = std::make_shared<async_logger>("as", sinks_init_list{oss_sink, test_sink}, tp, async_overflow_policy::spill);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+            expected += fmt::format("Hello message #{}\n", i);
+            if (i == messages / 2)
+            {
+                // queued after the spilled messages
+                logger->flush();
+            }
+        }
+        REQUIRE(details::os::file_exists(spill_filename));
+        // the logger never waited for room
+        REQUIRE(tp->telemetry().queues[0].blocked_time == std::chrono::nanoseconds::zero());
+        REQUIRE(tp->wait_processed());
+        auto stats = tp->telemetry().queues[0];
+        REQUIRE(stats.spilled > 0);
+        REQUIRE(stats.depth == 0);
+        REQUIRE(test_sink->msg_counter() == messages);
+        REQUIRE(test_sink->flush_counter() == 1);
+    }
+    REQUIRE(oss.str() == expected);
+    REQUIRE(!details::os::file_exists(spill_filename));
+}
+
+TEST_CASE("spill file with a blocking logger", "[async]")
+{
+    using namespace spdlog;
+    prepare_logdir();
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%n %v");
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 50;
+    std::string expected;
+    {
+        auto tp = std::make_shared<details::thread_pool>(4, 1);
+        tp->set_spill_file("logs/async_spill");
+        auto spilling = std::make_shared<async_logger>("spill", sinks_init_list{oss_sink, test_sink}, tp, async_overflow_policy::spill);
+        auto blocking = std::make_shared<async_logger>("block", sinks_init_list{oss_sink, test_sink}, tp, async_overflow_policy::block);
+        for (size_t i = 0; i < messages; i++)
+        {
+            spilling->info("#{}", i);
+            blocking->info("#{}", i);
+            expected += fmt::format("spill #{}\nblock #{}\n", i, i);
+        }
+        REQUIRE(tp->wait_processed());
+        REQUIRE(tp->telemetry().queues[0].spilled > 0);
+    }
+    // the blocking logger goes through the spill file too while it is in use
+    REQUIRE(oss.str() == expected);
+}
+
+TEST_CASE("create_async with overflow policy", "[async]")
+{
+    using namespace spdlog;
+    auto logger = spdlog::create_async<sinks::test_sink_mt, async_overflow_policy::discard_new>("as_discard");
+    logger->info("Hello message");
+    logger->flush();
+    REQUIRE(spdlog::get("as_discard") == logger);
+    auto as_timeout = async_factory_timeout::create<sinks::test_sink_mt>("as_timeout");
+    REQUIRE(as_timeout->block_timeout() == std::chrono::milliseconds(10));
+    spdlog::drop_all();
+}
+
+TEST_CASE("producer batching", "[async]")
+{
+    using namespace spdlog;
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%v");
+    auto tp = std::make_shared<details::thread_pool>(128, 1);
+    async_producer_batching batching;
+    batching.max_items = 8;
+    batching.max_delay = std::chrono::seconds(10);
+    tp->set_producer_batching(batching);
+    REQUIRE(tp->producer_batching().max_items == 8u);
+    auto logger = std::make_shared<async_logger>("as", oss_sink, tp);
+
+    for (int i = 0; i < 5; i++)
+    {
+        logger->info("{}", i);
+    }
+    // the first one wakes up the pool's thread, the others are staged
+    REQUIRE(tp->telemetry().queues[0].enqueued == 1u);
+    logger->error("5");
+    REQUIRE(tp->telemetry().queues[0].enqueued == 6u);
+    for (int i = 6; i < 20; i++)
+    {
+        logger->info("{}", i);
+    }
+    REQUIRE(tp->telemetry().queues[0].enqueued == 14u);
+
+    logger->flush_with_future().get();
+    std::string expected;
+    for (int i = 0; i < 20; i++)
+    {
+        expected += std::to_string(i) + "\n";
+    }
+    REQUIRE(oss.str() == expected);
+}
+
+TEST_CASE("producer batching max delay", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    auto tp = std::make_shared<details::thread_pool>(128, 1);
+    async_producer_batching batching;
+    batching.max_items = 64;
+    batching.max_delay = std::chrono::milliseconds(2);
+    tp->set_producer_batching(batching);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+    for (int i = 0; i < 3; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    // published by the pool's thread, without any further call from this one
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    logger->info("Hello message #3");
+    for (int i = 0; i < 1000 && test_sink->msg_counter() < 4; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(test_sink->msg_counter() == 4u);
+}
+
+TEST_CASE("producer batching thread exit", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    auto tp = std::make_shared<details::thread_pool>(128, 1);
+    async_producer_batching batching;
+    batching.max_items = 64;
+    batching.max_delay = std::chrono::seconds(10);
+    tp->set_producer_batching(batching);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+    std::thread producer([&logger] {
+        for (int i = 0; i < 3; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+    });
+    producer.join();
+    REQUIRE(tp->telemetry().queues[0].enqueued == 3u);
+    REQUIRE(tp->wait_processed());
+    REQUIRE(test_sink->msg_counter() == 3u);
+}
+
+TEST_CASE("set thread count", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    std::atomic<size_t> started{0};
+    std::atomic<size_t> stopped{0};
+    thread_options options;
+    options.on_start = [&started](size_t) { started++; };
+    options.on_stop = [&stopped](size_t) { stopped++; };
+    size_t messages = 256;
+    auto tp = std::make_shared<details::thread_pool>(128, 1, options);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+
+    tp->set_thread_count(4);
+    REQUIRE(tp->thread_count() == 4u);
+    REQUIRE(started == 4u);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+    REQUIRE(test_sink->msg_counter() == messages);
+
+    tp->set_thread_count(1);
+    REQUIRE(tp->thread_count() == 1u);
+    REQUIRE(stopped == 3u);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+    REQUIRE(test_sink->msg_counter() == 2 * messages);
+    REQUIRE_THROWS_AS(tp->set_thread_count(0), const spdlog_ex &);
+}
+
+TEST_CASE("autoscale", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    auto tp = std::make_shared<details::thread_pool>(1024, 1);
+    async_autoscale autoscale;
+    autoscale.max_threads = 3;
+    autoscale.grow_depth = 8;
+    autoscale.idle_shrink = std::chrono::milliseconds(20);
+    tp->set_autoscale(autoscale);
+    REQUIRE(tp->autoscale().max_threads == 3u);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp);
+
+    size_t messages = 200;
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    size_t max_threads = 0;
+    for (int i = 0; i < 1000 && test_sink->msg_counter() < messages; i++)
+    {
+        max_threads = std::max(max_threads, tp->thread_count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(max_threads > 1u);
+    REQUIRE(max_threads <= 3u);
+    REQUIRE(tp->wait_processed());
+    REQUIRE(test_sink->msg_counter() == messages);
+
+    // back to min_threads once idle
+    for (int i = 0; i < 1000 && tp->thread_count() > 1; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(tp->thread_count() == 1u);
+}
+
+TEST_CASE("sharded pool has a fixed thread count", "[async]")
+{
+    using namespace spdlog;
+    auto tp = std::make_shared<details::thread_pool>(128, 2, 1, async_queue_sharding::per_thread);
+    REQUIRE_THROWS_AS(tp->set_thread_count(3), const spdlog_ex &);
+    async_autoscale autoscale;
+    autoscale.max_threads = 4;
+    REQUIRE_THROWS_AS(tp->set_autoscale(autoscale), const spdlog_ex &);
+    REQUIRE(tp->thread_count() == 2u);
+}
+
+TEST_CASE("logger quota", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 50;
+    auto tp = std::make_shared<details::thread_pool>(1024, 1);
+    auto logger = std::make_shared<async_logger>("as", test_sink, tp, async_overflow_policy::discard_new);
+    logger->set_quota(4);
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->wait_processed());
+
+    auto *quota = tp->quota("as");
+    REQUIRE(quota->max_in_flight() == 4u);
+    REQUIRE(quota->rejected() > 0u);
+    REQUIRE(quota->in_flight() == 0u);
+    auto processed = test_sink->msg_counter() + quota->rejected();
+    REQUIRE(processed == messages);
+}
+
+TEST_CASE("quota group", "[async]")
+{
+    using namespace spdlog;
+    auto test_sink = std::make_shared<sinks::test_sink_mt>();
+    size_t messages = 100;
+    auto tp = std::make_shared<details::thread_pool>(1024, 1);
+    tp->set_quota("group", 2);
+    auto logger1 = std::make_shared<async_logger>("as1", test_sink, tp);
+    auto logger2 = std::make_shared<async_logger>("as2", test_sink, tp);
+    logger1->set_quota_group("group");
+    logger2->set_quota_group("group");
+    auto *quota = tp->quota("group");
+    size_t max_in_flight = 0;
+    for (size_t i = 0; i < messages; i++)
+    {
+        logger1->info("Hello message #{}", i);
+        logger2->info("Hello message #{}", i);
+        max_in_flight = std::max(max_in_flight, quota->in_flight());
+    }
+    REQUIRE(tp->wait_processed());
+    REQUIRE(max_in_flight <= 2u);
+    REQUIRE(quota->rejected() == 0u);
+    REQUIRE(test_sink->msg_counter() == 2 * messages);
+}
+
+TEST_CASE("fair drain", "[async]")
+{
+    using namespace spdlog;
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<sinks::ostream_sink_mt>(oss);
+    oss_sink->set_pattern("%n");
+    auto slow_sink = std::make_shared<sinks::test_sink_mt>();
+    slow_sink->set_delay(std::chrono::milliseconds(50));
+    {
+        auto tp = std::make_shared<details::thread_pool>(details::default_async_q_size, 1, 64);
+        tp->set_fair_drain_quantum(2);
+        REQUIRE(tp->fair_drain_quantum() == 2u);
+        auto slow = std::make_shared<async_logger>("slow", slow_sink, tp);
+        auto noisy = std::make_shared<async_logger>("noisy", oss_sink, tp);
+        auto quiet = std::make_shared<async_logger>("quiet", oss_sink, tp);
+        // keeps the thread busy while the others are queued
+        slow->info("slow");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (int i = 0; i < 40; i++)
+        {
+            noisy->info("noisy");
+        }
+        quiet->info("quiet");
+        REQUIRE(tp->wait_processed());
+    }
+    auto output = oss.str();
+    auto quiet_pos = output.find("quiet");
+    REQUIRE(quiet_pos != std::string::npos);
+    // after a turn of the noisy logger, not after all its messages
+    REQUIRE(quiet_pos <= 2 * std::string("noisy\n").size());
+}
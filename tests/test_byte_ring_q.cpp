@@ -0,0 +1,179 @@
+#include "includes.h"
+#include "spdlog/details/byte_ring_q.h"
+
+using std::chrono::milliseconds;
+using spdlog::details::async_msg;
+using spdlog::details::async_msg_type;
+using spdlog::details::byte_ring_blocking_queue;
+
+static async_msg make_msg(const std::string &payload)
+{
+    spdlog::details::log_msg msg(nullptr, spdlog::level::info, payload);
+    return async_msg(nullptr, async_msg_type::log, msg);
+}
+
+static std::string payload_of(const async_msg &msg)
+{
+    return std::string(msg.raw.data(), msg.raw.size());
+}
+
+TEST_CASE("byte-ring-empty", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(1024);
+    async_msg item;
+    REQUIRE(q.dequeue_for(item, milliseconds(10)) == false);
+}
+
+TEST_CASE("byte-ring-variable-sizes", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(4096);
+    std::vector<std::string> payloads{"", "a", std::string(300, 'x'), "hello", std::string(1000, 'y')};
+    for (auto &p : payloads)
+    {
+        q.enqueue(make_msg(p));
+    }
+
+    for (auto &p : payloads)
+    {
+        async_msg item;
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item.msg_type == async_msg_type::log);
+        REQUIRE(item.level == spdlog::level::info);
+        REQUIRE(payload_of(item) == p);
+    }
+    async_msg item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+}
+
+TEST_CASE("byte-ring-wrap-around", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(1024);
+    // odd sizes so records end at every offset of the ring
+    async_msg item;
+    for (int i = 0; i < 1000; i++)
+    {
+        auto p = std::to_string(i) + std::string(static_cast<size_t>(i % 97), 'z');
+        q.enqueue(make_msg(p));
+        q.enqueue(make_msg(p + "!"));
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(payload_of(item) == p);
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(payload_of(item) == p + "!");
+    }
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+}
+
+TEST_CASE("byte-ring-overrun", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(1024);
+    int pushed = 0;
+    // fill the queue with messages of 100 bytes, then keep pushing
+    for (; pushed < 50; pushed++)
+    {
+        q.enqueue_nowait(make_msg(std::to_string(pushed) + std::string(100, 'o')));
+    }
+    auto overrun = q.overrun_counter();
+    REQUIRE(overrun > 0);
+
+    // the oldest messages were dropped, the newest ones kept in order
+    async_msg item;
+    for (auto i = static_cast<int>(overrun); i < pushed; i++)
+    {
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(payload_of(item) == std::to_string(i) + std::string(100, 'o'));
+    }
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+}
+
+TEST_CASE("byte-ring-flush-promise", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(1024);
+    async_msg flush(async_msg_type::flush);
+    flush.flushed.reset(new std::promise<void>());
+    auto kept = flush.flushed->get_future();
+    q.enqueue_nowait(std::move(flush));
+
+    async_msg item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item.flushed);
+    item.flushed->set_value();
+    REQUIRE(kept.wait_for(milliseconds(0)) == std::future_status::ready);
+
+    // a dropped flush breaks its promise
+    async_msg dropped_flush(async_msg_type::flush);
+    dropped_flush.flushed.reset(new std::promise<void>());
+    auto dropped = dropped_flush.flushed->get_future();
+    q.enqueue_nowait(std::move(dropped_flush));
+    for (int i = 0; i < 20; i++)
+    {
+        q.enqueue_nowait(make_msg(std::string(100, 'o')));
+    }
+    REQUIRE(q.overrun_counter() > 0);
+    REQUIRE_THROWS_AS(dropped.get(), const std::future_error &);
+}
+
+TEST_CASE("byte-ring-too-large", "[byte_ring_q]")
+{
+    byte_ring_blocking_queue q(1024);
+    REQUIRE_THROWS_AS(q.enqueue(make_msg(std::string(1024, 'x'))), const spdlog::spdlog_ex &);
+    q.enqueue(make_msg("fits"));
+    async_msg item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(payload_of(item) == "fits");
+}
+
+TEST_CASE("byte-ring-min-size", "[byte_ring_q]")
+{
+    // tiny sizes are raised so messages of typical size still fit
+    byte_ring_blocking_queue q(4);
+    q.enqueue(make_msg("Hello message"));
+    async_msg item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(payload_of(item) == "Hello message");
+}
+
+TEST_CASE("byte-ring-multi-producers", "[byte_ring_q]")
+{
+    size_t n_threads = 8;
+    int per_thread = 5000;
+    byte_ring_blocking_queue q(2048);
+
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < n_threads; t++)
+    {
+        producers.emplace_back([&q, per_thread, t] {
+            for (int i = 0; i < per_thread; i++)
+            {
+                auto p = std::to_string(t) + ":" + std::to_string(i) + std::string(static_cast<size_t>(i % 50), '.');
+                q.enqueue(make_msg(p));
+            }
+        });
+    }
+
+    // messages of each producer must come out in the order they were put in
+    std::vector<int> last_seen(n_threads, -1);
+    async_msg items[16];
+    int total = 0;
+    while (total < static_cast<int>(n_threads) * per_thread)
+    {
+        auto n = q.dequeue_bulk_for(items, 16, milliseconds(1000));
+        REQUIRE(n > 0);
+        for (size_t k = 0; k < n; k++)
+        {
+            auto p = payload_of(items[k]);
+            auto colon = p.find(':');
+            auto t = std::stoul(p.substr(0, colon));
+            auto i = std::stoi(p.substr(colon + 1));
+            REQUIRE(i == last_seen[t] + 1);
+            REQUIRE(p.size() == colon + 1 + std::to_string(i).size() + static_cast<size_t>(i % 50));
+            last_seen[t] = i;
+        }
+        total += static_cast<int>(n);
+    }
+
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+    REQUIRE(q.overrun_counter() == 0);
+}
@@ -171,3 +171,46 @@ TEST_CASE("daily_file_sink::daily_filename_calculator", "[daily_file_sink]]")
     REQUIRE(std::regex_match(filename, match, re));
 }
 #endif
+
+static std::vector<spdlog::details::log_msg> make_batch(const std::string *logger_name, const std::vector<std::string> &payloads)
+{
+    std::vector<spdlog::details::log_msg> msgs;
+    for (auto &payload : payloads)
+    {
+        msgs.emplace_back(logger_name, spdlog::level::info, spdlog::string_view_t(payload.data(), payload.size()));
+    }
+    return msgs;
+}
+
+TEST_CASE("simple_file_batch", "[log_batch]]")
+{
+    prepare_logdir();
+    std::string filename = "logs/simple_log";
+    std::string logger_name = "logger";
+    spdlog::sinks::basic_file_sink_mt sink(filename);
+    sink.set_pattern("%v");
+
+    std::vector<std::string> payloads{"Test message 1", "Test message 2", "Test message 3"};
+    auto msgs = make_batch(&logger_name, payloads);
+    sink.log_batch(msgs.data(), msgs.size());
+    sink.flush();
+    REQUIRE(file_contents(filename) == std::string("Test message 1\nTest message 2\nTest message 3\n"));
+}
+
+TEST_CASE("rotating_file_batch", "[log_batch]]")
+{
+    prepare_logdir();
+    std::string basename = "logs/rotating_log";
+    std::string logger_name = "logger";
+    // room for 2 messages per file
+    spdlog::sinks::rotating_file_sink_mt sink(basename, 32, 2);
+    sink.set_pattern("%v");
+
+    std::vector<std::string> payloads{"Test message 1", "Test message 2", "Test message 3", "Test message 4", "Test message 5"};
+    auto msgs = make_batch(&logger_name, payloads);
+    sink.log_batch(msgs.data(), msgs.size());
+    sink.flush();
+    REQUIRE(file_contents(basename) == std::string("Test message 5\n"));
+    REQUIRE(file_contents(basename + ".1") == std::string("Test message 3\nTest message 4\n"));
+    REQUIRE(file_contents(basename + ".2") == std::string("Test message 1\nTest message 2\n"));
+}
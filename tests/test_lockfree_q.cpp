@@ -0,0 +1,159 @@
+#include "includes.h"
+#include "spdlog/details/lockfree_blocking_q.h"
+
+using namespace std::chrono;
+using std::chrono::milliseconds;
+using test_clock = std::chrono::high_resolution_clock;
+
+static milliseconds millis_from(const test_clock::time_point &tp0)
+{
+    return std::chrono::duration_cast<milliseconds>(test_clock::now() - tp0);
+}
+
+TEST_CASE("ring_capacity", "[lockfree_q]")
+{
+    REQUIRE(spdlog::details::lockfree_ring<int>(0).capacity() == 1);
+    REQUIRE(spdlog::details::lockfree_ring<int>(100).capacity() == 128);
+    REQUIRE(spdlog::details::lockfree_ring<int>(128).capacity() == 128);
+}
+
+TEST_CASE("ring_push_pop", "[lockfree_q]")
+{
+    spdlog::details::lockfree_ring<int> ring(4);
+    for (int i = 0; i < 4; i++)
+    {
+        REQUIRE(ring.try_push(std::move(i)));
+    }
+    REQUIRE(ring.try_push(100) == false);
+    REQUIRE(ring.size() == 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        int item = -1;
+        REQUIRE(ring.try_pop(item));
+        REQUIRE(item == i);
+    }
+    int item;
+    REQUIRE(ring.try_pop(item) == false);
+    REQUIRE(ring.empty());
+}
+
+TEST_CASE("lockfree-dequeue-empty-nowait", "[lockfree_q]")
+{
+    size_t q_size = 100;
+    milliseconds tolerance_wait(10);
+    spdlog::details::lockfree_blocking_queue<int> q(q_size);
+    int popped_item;
+
+    auto start = test_clock::now();
+    auto rv = q.dequeue_bulk_for(&popped_item, 1, milliseconds::zero());
+    auto delta_ms = millis_from(start);
+
+    REQUIRE(rv == 0);
+    INFO("Delta " << delta_ms.count() << " millis");
+    REQUIRE(delta_ms <= tolerance_wait);
+
+    q.enqueue(42);
+    REQUIRE(q.dequeue_bulk_for(&popped_item, 1, milliseconds::zero()) == 1);
+    REQUIRE(popped_item == 42);
+}
+
+TEST_CASE("lockfree-dequeue-empty-wait", "[lockfree_q]")
+{
+    size_t q_size = 100;
+    milliseconds wait_ms(250);
+    milliseconds tolerance_wait(50);
+
+    spdlog::details::lockfree_blocking_queue<int> q(q_size);
+    int popped_item;
+    auto start = test_clock::now();
+    auto rv = q.dequeue_for(popped_item, wait_ms);
+    auto delta_ms = millis_from(start);
+
+    REQUIRE(rv == false);
+
+    INFO("Delta " << delta_ms.count() << " millis");
+    REQUIRE(delta_ms >= wait_ms - tolerance_wait);
+    REQUIRE(delta_ms <= wait_ms + tolerance_wait);
+}
+
+TEST_CASE("lockfree-full_queue", "[lockfree_q]")
+{
+    size_t q_size = 128;
+    spdlog::details::lockfree_blocking_queue<int> q(q_size);
+    for (int i = 0; i < static_cast<int>(q_size); i++)
+    {
+        q.enqueue(std::move(i));
+    }
+
+    q.enqueue_nowait(123456);
+    REQUIRE(q.overrun_counter() == 1);
+
+    for (int i = 1; i < static_cast<int>(q_size); i++)
+    {
+        int item = -1;
+        q.dequeue_for(item, milliseconds(0));
+        REQUIRE(item == i);
+    }
+
+    // last item pushed has overridden the oldest.
+    int item = -1;
+    q.dequeue_for(item, milliseconds(0));
+    REQUIRE(item == 123456);
+}
+
+TEST_CASE("lockfree-multi-producers", "[lockfree_q]")
+{
+    size_t q_size = 16;
+    size_t n_threads = 8;
+    size_t per_thread = 10000;
+    spdlog::details::lockfree_blocking_queue<size_t> q(q_size);
+
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < n_threads; t++)
+    {
+        producers.emplace_back([&q, per_thread] {
+            for (size_t i = 1; i <= per_thread; i++)
+            {
+                q.enqueue(std::move(i));
+            }
+        });
+    }
+
+    size_t sum = 0;
+    for (size_t i = 0; i < n_threads * per_thread; i++)
+    {
+        size_t item = 0;
+        REQUIRE(q.dequeue_for(item, milliseconds(1000)));
+        sum += item;
+    }
+
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+    size_t item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+    REQUIRE(sum == n_threads * per_thread * (per_thread + 1) / 2);
+    REQUIRE(q.overrun_counter() == 0);
+}
+
+TEST_CASE("lockfree-dequeue_bulk", "[lockfree_q]")
+{
+    spdlog::details::lockfree_blocking_queue<int> q(16);
+    for (int i = 0; i < 7; i++)
+    {
+        q.enqueue(std::move(i));
+    }
+
+    int items[5];
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(0)) == 5);
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE(items[i] == i);
+    }
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(0)) == 2);
+    REQUIRE(items[0] == 5);
+    REQUIRE(items[1] == 6);
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(10)) == 0);
+}
@@ -231,3 +231,115 @@ TEST_CASE("default logger API", "[default logger]")
     spdlog::drop_all();
     spdlog::set_pattern("%v");
 }
+
+TEST_CASE("shared format", "[shared_format]")
+{
+    std::ostringstream oss1, oss2, oss3, oss4;
+    auto sink1 = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss1);
+    auto sink2 = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss2);
+    auto sink3 = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss3);
+    auto sink4 = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss4);
+    spdlog::logger logger("shared", {sink1, sink2, sink3, sink4});
+    logger.set_pattern("[%n] %v");
+    sink3->set_pattern("%v");
+    sink4->set_formatter(spdlog::details::make_unique<spdlog::pattern_formatter>("[%n] %v", spdlog::pattern_time_type::local, ""));
+
+    logger.info("Hello");
+    logger.info("Hello {}", 2);
+    auto eol = std::string(spdlog::details::os::default_eol);
+    REQUIRE(oss1.str() == "[shared] Hello" + eol + "[shared] Hello 2" + eol);
+    REQUIRE(oss2.str() == oss1.str());
+    REQUIRE(oss3.str() == "Hello" + eol + "Hello 2" + eol);
+    REQUIRE(oss4.str() == "[shared] Hello[shared] Hello 2");
+}
+
+TEST_CASE("shared format once", "[shared_format]")
+{
+    struct counting_formatter : spdlog::formatter
+    {
+        explicit counting_formatter(std::shared_ptr<size_t> counter)
+            : counter_(std::move(counter))
+        {
+        }
+
+        void format(const spdlog::details::log_msg &msg, fmt::memory_buffer &dest) override
+        {
+            (*counter_)++;
+            dest.append(msg.payload.data(), msg.payload.data() + msg.payload.size());
+        }
+
+        std::unique_ptr<spdlog::formatter> clone() const override
+        {
+            return spdlog::details::make_unique<counting_formatter>(counter_);
+        }
+
+        spdlog::string_view_t format_key() const override
+        {
+            return "counting";
+        }
+
+        std::shared_ptr<size_t> counter_;
+    };
+
+    std::ostringstream oss;
+    auto counter = std::make_shared<size_t>(0);
+    spdlog::logger logger("shared", {std::make_shared<spdlog::sinks::ostream_sink_mt>(oss),
+                                        std::make_shared<spdlog::sinks::ostream_sink_mt>(oss),
+                                        std::make_shared<spdlog::sinks::ostream_sink_mt>(oss)});
+    logger.set_formatter(spdlog::details::make_unique<counting_formatter>(counter));
+
+    logger.info("x");
+    REQUIRE(oss.str() == "xxx");
+    REQUIRE(*counter == 1);
+}
+
+#ifndef _WIN32
+static void require_same_tm(const std::tm &expected, const std::tm &actual)
+{
+    REQUIRE(actual.tm_year == expected.tm_year);
+    REQUIRE(actual.tm_mon == expected.tm_mon);
+    REQUIRE(actual.tm_mday == expected.tm_mday);
+    REQUIRE(actual.tm_hour == expected.tm_hour);
+    REQUIRE(actual.tm_min == expected.tm_min);
+    REQUIRE(actual.tm_sec == expected.tm_sec);
+    REQUIRE(actual.tm_wday == expected.tm_wday);
+    REQUIRE(actual.tm_yday == expected.tm_yday);
+    REQUIRE(actual.tm_isdst == expected.tm_isdst);
+    REQUIRE(spdlog::details::os::utc_minutes_offset(actual) == spdlog::details::os::utc_minutes_offset(expected));
+}
+
+TEST_CASE("local time converter", "[local_time]")
+{
+    // a zone with dst, that needs no tz database
+    std::string old_tz = getenv("TZ") ? getenv("TZ") : "";
+    bool had_tz = getenv("TZ") != nullptr;
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+
+    spdlog::details::local_time_converter converter;
+    // 2018-03-11 07:00:00 utc, the start of dst
+    const std::time_t transition = 1520751600;
+    for (std::time_t t = transition - 2 * 3600; t < transition + 2 * 3600; t += 17)
+    {
+        require_same_tm(spdlog::details::os::localtime(t), converter.localtime(t));
+    }
+    REQUIRE(converter.utc_minutes_offset(transition - 1) == -5 * 60);
+    REQUIRE(converter.utc_minutes_offset(transition) == -4 * 60);
+
+    // days across the years, backwards as well
+    for (std::time_t t = 1600000000; t > 0; t -= 86400 * 7 + 3671)
+    {
+        require_same_tm(spdlog::details::os::localtime(t), converter.localtime(t));
+    }
+
+    if (had_tz)
+    {
+        setenv("TZ", old_tz.c_str(), 1);
+    }
+    else
+    {
+        unsetenv("TZ");
+    }
+    tzset();
+}
+#endif
@@ -104,4 +104,48 @@ TEST_CASE("full_queue", "[mpmc_blocking_q]")
     int item = -1;
     q.dequeue_for(item, milliseconds(0));
     REQUIRE(item == 123456);
-}
\ No newline at end of file
+}
+TEST_CASE("dequeue_bulk", "[mpmc_blocking_q]")
+{
+    size_t q_size = 10;
+    spdlog::details::mpmc_blocking_queue<int> q(q_size);
+    for (int i = 0; i < 7; i++)
+    {
+        q.enqueue(std::move(i));
+    }
+
+    int items[5];
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(0)) == 5);
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE(items[i] == i);
+    }
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(0)) == 2);
+    REQUIRE(items[0] == 5);
+    REQUIRE(items[1] == 6);
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(10)) == 0);
+}
+
+TEST_CASE("queue_memory", "[mpmc_blocking_q]")
+{
+    spdlog::async_queue_memory memory;
+    memory.prefault = true;
+    memory.huge_pages = true;
+    size_t q_size = 100000;
+    spdlog::details::mpmc_blocking_queue<std::string> q(q_size, memory);
+    for (int i = 0; i < static_cast<int>(q_size); i++)
+    {
+        q.enqueue(std::to_string(i));
+    }
+    q.enqueue_nowait("overrun");
+    REQUIRE(q.overrun_counter() == 1);
+
+    std::string item;
+    for (int i = 1; i < static_cast<int>(q_size); i++)
+    {
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item == std::to_string(i));
+    }
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item == "overrun");
+}
@@ -1,4 +1,5 @@
 #include "includes.h"
+#include "spdlog/details/compiled_pattern_formatter.h"
 
 // log to str and return it
 template<typename... Args>
@@ -253,3 +254,95 @@ TEST_CASE("clone-formatter-2", "[pattern_formatter]")
     formatter_2->format(msg, formatted_2);
     REQUIRE(fmt::to_string(formatted_1) == fmt::to_string(formatted_2));
 }
+
+// format the same message with the compiled and the runtime formatter of the pattern
+template<typename Pattern>
+static void require_same_as_runtime(spdlog::pattern_time_type time_type = spdlog::pattern_time_type::local)
+{
+    spdlog::compiled_pattern_formatter<Pattern> compiled(time_type, "\n");
+    auto cloned = compiled.clone();
+    spdlog::pattern_formatter runtime(Pattern::value(), time_type, "\n");
+    std::string logger_name = "test";
+    spdlog::details::log_msg msg(&logger_name, spdlog::level::warn, "some message");
+    msg.source = spdlog::source_loc{"some/file.cpp", 42};
+
+    fmt::memory_buffer formatted_1;
+    fmt::memory_buffer formatted_2;
+    fmt::memory_buffer formatted_3;
+    compiled.format(msg, formatted_1);
+    auto color_range_start = msg.color_range_start;
+    auto color_range_end = msg.color_range_end;
+    runtime.format(msg, formatted_2);
+    cloned->format(msg, formatted_3);
+    REQUIRE(fmt::to_string(formatted_1) == fmt::to_string(formatted_2));
+    REQUIRE(fmt::to_string(formatted_3) == fmt::to_string(formatted_2));
+    REQUIRE(color_range_start == msg.color_range_start);
+    REQUIRE(color_range_end == msg.color_range_end);
+}
+
+SPDLOG_COMPILED_PATTERN(full_pattern, "%+");
+SPDLOG_COMPILED_PATTERN(time_pattern, "[%H:%M:%S.%e] [%l] %v");
+SPDLOG_COMPILED_PATTERN(
+    all_flags_pattern, "%v %t %P %n %l %L %a %A %b %h %B %c %C %Y %D %x %m %d "
+                       "%H %I %M %S %e %f %F %E %p %r %R %T %X %z %i");
+SPDLOG_COMPILED_PATTERN(source_pattern, "[%@] [%s:%#] %v");
+SPDLOG_COMPILED_PATTERN(padded_pattern, "[%8l] [%-8n] [%=9v] [%3L] [%200n] [%-0v] [%5%] [%=q] %%%");
+SPDLOG_COMPILED_PATTERN(padded_time_pattern, "[%12D] [%-10T] [%=6Y] [%3m] [%-4e] [%=8R] [%4p] [%3t]");
+SPDLOG_COMPILED_PATTERN(color_pattern, "XX%^%l%$ %v");
+SPDLOG_COMPILED_PATTERN(literal_pattern, "no flags");
+SPDLOG_COMPILED_PATTERN(empty_pattern, "");
+SPDLOG_COMPILED_PATTERN(trailing_pad_pattern, "%v %-12");
+
+TEST_CASE("compiled pattern", "[pattern_formatter]")
+{
+    require_same_as_runtime<full_pattern>();
+    require_same_as_runtime<time_pattern>();
+    require_same_as_runtime<time_pattern>(spdlog::pattern_time_type::utc);
+    require_same_as_runtime<all_flags_pattern>();
+    require_same_as_runtime<source_pattern>();
+    require_same_as_runtime<padded_pattern>();
+    require_same_as_runtime<padded_time_pattern>();
+    require_same_as_runtime<color_pattern>();
+    require_same_as_runtime<literal_pattern>();
+    require_same_as_runtime<empty_pattern>();
+    require_same_as_runtime<trailing_pad_pattern>();
+}
+
+TEST_CASE("compiled pattern of a logger", "[pattern_formatter]")
+{
+    SPDLOG_COMPILED_PATTERN(pattern, "[%n] [%l] %v");
+    std::ostringstream oss;
+    auto oss_sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(oss);
+    spdlog::logger oss_logger("pattern_tester", oss_sink);
+    oss_logger.set_formatter(spdlog::details::make_unique<spdlog::compiled_pattern_formatter<pattern>>());
+    oss_logger.info("Some message");
+    REQUIRE(oss.str() == std::string("[pattern_tester] [info] Some message") + spdlog::details::os::default_eol);
+}
+
+TEST_CASE("unknown flags", "[pattern_formatter]")
+{
+    REQUIRE(log_to_str("Some message", "%q%%%-5Z%5%[%v]%", spdlog::pattern_time_type::local, "\n") == "%q%%Z%[Some message]\n");
+}
+
+SPDLOG_COMPILED_PATTERN(iso_pattern, "%Y-%m-%dT%H:%M:%S.%f%z [%5S] %v %E");
+
+TEST_CASE("datetime runs", "[pattern_formatter]")
+{
+    // the cached date/time text follows the seconds of the messages
+    spdlog::compiled_pattern_formatter<iso_pattern> compiled(spdlog::pattern_time_type::utc, "\n");
+    spdlog::pattern_formatter runtime(iso_pattern::value(), spdlog::pattern_time_type::utc, "\n");
+    std::string logger_name = "test";
+    spdlog::details::log_msg msg(&logger_name, spdlog::level::info, "some message");
+    auto start = std::chrono::time_point_cast<std::chrono::seconds>(msg.time);
+    const std::chrono::milliseconds offsets[] = {
+        std::chrono::milliseconds(0), std::chrono::milliseconds(250), std::chrono::milliseconds(1001), std::chrono::milliseconds(500)};
+    for (auto offset : offsets)
+    {
+        msg.time = start + offset;
+        fmt::memory_buffer formatted_1;
+        fmt::memory_buffer formatted_2;
+        compiled.format(msg, formatted_1);
+        runtime.format(msg, formatted_2);
+        REQUIRE(fmt::to_string(formatted_1) == fmt::to_string(formatted_2));
+    }
+}
@@ -0,0 +1,128 @@
+#include "includes.h"
+#include "spdlog/details/per_thread_q.h"
+
+using std::chrono::milliseconds;
+
+namespace {
+struct timed_item
+{
+    int time = 0;
+    int value = 0;
+};
+} // namespace
+
+using timed_queue = spdlog::details::per_thread_blocking_queue<timed_item>;
+
+static timed_item make_item(int time, int value)
+{
+    timed_item item;
+    item.time = time;
+    item.value = value;
+    return item;
+}
+
+TEST_CASE("per-thread-empty", "[per_thread_q]")
+{
+    timed_queue q(10);
+    timed_item item;
+    REQUIRE(q.dequeue_for(item, milliseconds(10)) == false);
+}
+
+TEST_CASE("per-thread-merge-by-time", "[per_thread_q]")
+{
+    timed_queue q(10);
+
+    // each thread enqueues its own (ordered) items
+    std::thread t1([&q] {
+        q.enqueue(make_item(1, 1));
+        q.enqueue(make_item(4, 1));
+        q.enqueue(make_item(5, 1));
+    });
+    t1.join();
+    std::thread t2([&q] {
+        q.enqueue(make_item(2, 2));
+        q.enqueue(make_item(3, 2));
+        q.enqueue(make_item(6, 2));
+    });
+    t2.join();
+
+    for (int expected_time = 1; expected_time <= 6; expected_time++)
+    {
+        timed_item item;
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item.time == expected_time);
+    }
+    timed_item item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+}
+
+TEST_CASE("per-thread-overrun", "[per_thread_q]")
+{
+    timed_queue q(4);
+    for (int i = 0; i < 4; i++)
+    {
+        q.enqueue(make_item(i, i));
+    }
+    q.enqueue_nowait(make_item(10, 10));
+    REQUIRE(q.overrun_counter() == 1);
+
+    // the oldest item of this thread was overrun
+    timed_item item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item.value == 1);
+}
+
+TEST_CASE("per-thread-multi-producers", "[per_thread_q]")
+{
+    size_t q_size = 8;
+    int n_threads = 8;
+    int per_thread = 5000;
+    timed_queue q(q_size);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < n_threads; t++)
+    {
+        producers.emplace_back([&q, per_thread, t] {
+            for (int i = 0; i < per_thread; i++)
+            {
+                q.enqueue(make_item(i, t));
+            }
+        });
+    }
+
+    // items of each producer must come out in the order they were put in
+    std::vector<int> last_seen(static_cast<size_t>(n_threads), -1);
+    for (int i = 0; i < n_threads * per_thread; i++)
+    {
+        timed_item item;
+        REQUIRE(q.dequeue_for(item, milliseconds(1000)));
+        auto &last = last_seen[static_cast<size_t>(item.value)];
+        REQUIRE(item.time == last + 1);
+        last = item.time;
+    }
+
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+    REQUIRE(q.overrun_counter() == 0);
+}
+
+TEST_CASE("per-thread-dequeue_bulk", "[per_thread_q]")
+{
+    timed_queue q(10);
+    std::thread t1([&q] {
+        q.enqueue(make_item(1, 1));
+        q.enqueue(make_item(3, 1));
+    });
+    t1.join();
+    q.enqueue(make_item(2, 0));
+
+    timed_item items[5];
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(0)) == 3);
+    for (int i = 0; i < 3; i++)
+    {
+        REQUIRE(items[i].time == i + 1);
+    }
+    REQUIRE(q.dequeue_bulk_for(items, 5, milliseconds(10)) == 0);
+}